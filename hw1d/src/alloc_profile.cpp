@@ -0,0 +1,328 @@
+/**
+ * @file alloc_profile.cpp
+ *
+ * @copyright 2022 Zecheng Qian, All rights reserved.
+ */
+#include "alloc_profile.h"
+
+#ifdef RAYTRACER_ALLOC_PROFILE
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <atomic>
+#include <mutex>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <execinfo.h>
+#include <cxxabi.h>
+#include "stats.h"
+
+// frames recorded per allocation, the first is the profiler itself and is dropped
+#define ALLOC_FRAMES 6
+// slots of the call site table, once it is three quarters full new sites only count in the totals
+#define ALLOC_SITES 4096
+
+namespace
+{
+typedef struct AllocSiteType
+{
+    bool used;
+    void *frames[ALLOC_FRAMES - 1];
+    int depth;
+    uint64_t count[ALLOC_PHASES];
+    uint64_t bytes[ALLOC_PHASES];
+} AllocSite;
+
+// everything here is statically allocated, it is used from inside operator new,
+// possibly before the constructors of other globals have run
+std::atomic<int> process_phase(ALLOC_STARTUP);
+thread_local int thread_phase = -1;
+// set while the calling thread is inside the profiler, allocations made by backtrace are not counted
+thread_local bool inside = false;
+std::atomic<uint64_t> phase_count[ALLOC_PHASES];
+std::atomic<uint64_t> phase_bytes[ALLOC_PHASES];
+std::mutex sites_mutex;
+AllocSite sites[ALLOC_SITES];
+size_t num_sites = 0;
+uint64_t lost_sites = 0;
+
+size_t hash_frames(void *const *frames, int depth)
+{
+    size_t h = 1469598103934665603ull;
+    for (int k = 0; k < depth; k++)
+    {
+        h = (h ^ reinterpret_cast<size_t>(frames[k])) * 1099511628211ull;
+    }
+    return h;
+}
+
+// the site of the frames, NULL when the table is full
+AllocSite *find_site(void *const *frames, int depth)
+{
+    size_t slot = hash_frames(frames, depth) % ALLOC_SITES;
+    for (size_t probe = 0; probe < ALLOC_SITES; probe++, slot = (slot + 1) % ALLOC_SITES)
+    {
+        AllocSite &site = sites[slot];
+        if (!site.used)
+        {
+            // keep the table at most three quarters full so probes stay short
+            if (num_sites >= ALLOC_SITES * 3 / 4)
+            {
+                return NULL;
+            }
+            site.used = true;
+            site.depth = depth;
+            std::copy(frames, frames + depth, site.frames);
+            num_sites++;
+            return &site;
+        }
+        if (site.depth == depth && std::equal(frames, frames + depth, site.frames))
+        {
+            return &site;
+        }
+    }
+    return NULL;
+}
+
+// count an allocation of size bytes made from the calling thread
+void record(size_t size)
+{
+    if (inside)
+    {
+        return;
+    }
+    inside = true;
+    int phase = thread_phase >= 0 ? thread_phase : process_phase.load(std::memory_order_relaxed);
+    phase_count[phase].fetch_add(1, std::memory_order_relaxed);
+    phase_bytes[phase].fetch_add(size, std::memory_order_relaxed);
+    void *frames[ALLOC_FRAMES];
+    int depth = std::max(0, backtrace(frames, ALLOC_FRAMES) - 1);
+    {
+        std::lock_guard<std::mutex> lock(sites_mutex);
+        AllocSite *site = find_site(frames + 1, depth);
+        if (site != NULL)
+        {
+            site->count[phase]++;
+            site->bytes[phase] += size;
+        }
+        else
+        {
+            lost_sites++;
+        }
+    }
+    inside = false;
+}
+
+void *allocate(size_t size)
+{
+    record(size);
+    void *p = malloc(size == 0 ? 1 : size);
+    if (p == NULL)
+    {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+// the function name of a frame, demangled when the symbol is known
+std::string frame_name(void *frame)
+{
+    char **symbols = backtrace_symbols(&frame, 1);
+    if (symbols == NULL)
+    {
+        return "?";
+    }
+    // binary(mangled+offset) [address]
+    std::string symbol = symbols[0];
+    free(symbols);
+    size_t open = symbol.find('(');
+    size_t plus = symbol.find('+', open);
+    if (open == std::string::npos || plus == std::string::npos || plus == open + 1)
+    {
+        return symbol;
+    }
+    std::string mangled = symbol.substr(open + 1, plus - open - 1);
+    int status = 0;
+    char *demangled = abi::__cxa_demangle(mangled.c_str(), NULL, NULL, &status);
+    std::string name = status == 0 && demangled != NULL ? demangled : mangled;
+    free(demangled);
+    // the template arguments of the standard containers make the names unreadable
+    if (name.size() > 100)
+    {
+        name = name.substr(0, 97) + "...";
+    }
+    return name;
+}
+
+uint64_t site_total(const AllocSite &site)
+{
+    uint64_t total = 0;
+    for (int p = 0; p < ALLOC_PHASES; p++)
+    {
+        total += site.count[p];
+    }
+    return total;
+}
+
+bool busier(const AllocSite *a, const AllocSite *b)
+{
+    // the sites allocating while rendering come first, they are the ones to fix
+    if (a->count[ALLOC_RENDER] != b->count[ALLOC_RENDER])
+    {
+        return a->count[ALLOC_RENDER] > b->count[ALLOC_RENDER];
+    }
+    return site_total(*a) > site_total(*b);
+}
+} // namespace
+
+void *operator new(size_t size)
+{
+    return allocate(size);
+}
+
+void *operator new[](size_t size)
+{
+    return allocate(size);
+}
+
+void *operator new(size_t size, const std::nothrow_t &) noexcept
+{
+    record(size);
+    return malloc(size == 0 ? 1 : size);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) noexcept
+{
+    record(size);
+    return malloc(size == 0 ? 1 : size);
+}
+
+void operator delete(void *p) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void *p, const std::nothrow_t &) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void *p, const std::nothrow_t &) noexcept
+{
+    free(p);
+}
+
+AllocPhaseScope::AllocPhaseScope(AllocPhase phase, bool thread)
+    : thread(thread)
+{
+    if (thread)
+    {
+        this->previous = thread_phase;
+        thread_phase = phase;
+    }
+    else
+    {
+        this->previous = process_phase.exchange(phase);
+    }
+}
+
+AllocPhaseScope::~AllocPhaseScope()
+{
+    if (this->thread)
+    {
+        thread_phase = this->previous;
+    }
+    else
+    {
+        process_phase.store(this->previous);
+    }
+}
+
+bool check_render_allocations()
+{
+    const char *env = getenv("RAYTRACER_ALLOC_STRICT");
+    uint64_t count = phase_count[ALLOC_RENDER].load();
+    if (env == NULL || std::string(env) != "1" || count == 0)
+    {
+        return true;
+    }
+    fprintf(stderr, "Error: %llu allocations while rendering after the first row\n", (unsigned long long)count);
+    return false;
+}
+
+void print_alloc_profile(uint64_t pixels)
+{
+    static const char *phases[ALLOC_PHASES] = {"startup", "parse", "build", "warmup", "render", "output"};
+    inside = true;
+    fprintf(stderr, "%-10s %14s %16s\n", "allocs", "count", "bytes");
+    for (int p = 0; p < ALLOC_PHASES; p++)
+    {
+        fprintf(stderr, "%-10s %14llu %16llu\n", phases[p], (unsigned long long)phase_count[p].load(),
+                (unsigned long long)phase_bytes[p].load());
+    }
+    uint64_t rays = pixels;
+    const char *unit = "pixel";
+#ifdef RAYTRACER_STATS
+    RayStats stats = collect_stats();
+    rays = 0;
+    unit = "ray";
+    for (int c = 0; c < RAY_CATEGORIES; c++)
+    {
+        rays += stats.rays[c];
+    }
+#endif
+    uint64_t render = phase_count[ALLOC_WARMUP].load() + phase_count[ALLOC_RENDER].load();
+    fprintf(stderr, "%.4f allocations per %s while rendering, %llu after the first row\n",
+            rays > 0 ? double(render) / rays : 0.0, unit, (unsigned long long)phase_count[ALLOC_RENDER].load());
+
+    std::lock_guard<std::mutex> lock(sites_mutex);
+    std::vector<const AllocSite *> busiest;
+    for (size_t k = 0; k < ALLOC_SITES; k++)
+    {
+        if (sites[k].used)
+        {
+            busiest.push_back(&sites[k]);
+        }
+    }
+    std::sort(busiest.begin(), busiest.end(), busier);
+    busiest.resize(std::min(busiest.size(), size_t(12)));
+    for (size_t k = 0; k < busiest.size(); k++)
+    {
+        const AllocSite &site = *busiest[k];
+        fprintf(stderr, "site %zu: %llu allocations", k + 1, (unsigned long long)site_total(site));
+        for (int p = 0; p < ALLOC_PHASES; p++)
+        {
+            if (site.count[p] > 0)
+            {
+                fprintf(stderr, ", %llu in %s", (unsigned long long)site.count[p], phases[p]);
+            }
+        }
+        fprintf(stderr, "\n");
+        // the frames of operator new itself tell nothing
+        bool callers = false;
+        for (int f = 0; f < site.depth; f++)
+        {
+            std::string name = frame_name(site.frames[f]);
+            callers = callers || name.compare(0, 12, "operator new") != 0;
+            if (callers)
+            {
+                fprintf(stderr, "    %s\n", name.c_str());
+            }
+        }
+    }
+    if (lost_sites > 0)
+    {
+        fprintf(stderr, "%llu allocations came from sites beyond the first %zu\n", (unsigned long long)lost_sites, num_sites);
+    }
+    inside = false;
+}
+
+#endif // RAYTRACER_ALLOC_PROFILE
@@ -0,0 +1,60 @@
+/**
+ * @file alloc_profile.h
+ *
+ * @copyright 2022 Zecheng Qian, All rights reserved.
+ */
+#ifndef SRC_ALLOC_PROFILE_H_
+#define SRC_ALLOC_PROFILE_H_
+
+#include <cstdint>
+
+// an allocation profiler, built in with make ALLOCS=1, which replaces the global operator new
+// to count the allocations and their bytes by phase and by call site, the call site being
+// the few frames above operator new
+// images are allocated with posix_memalign and are not seen, see memory_usage.h for them
+
+// the phases the allocations are attributed to
+enum AllocPhase
+{
+    ALLOC_STARTUP, // before the scene is parsed
+    ALLOC_PARSE,
+    ALLOC_BUILD,   // setting up the view and the framebuffers, and the rest of main between phases
+    ALLOC_WARMUP,  // the first row, where lazily created buffers are allowed to allocate
+    ALLOC_RENDER,  // every other row, which should not allocate at all
+    ALLOC_OUTPUT,
+    ALLOC_PHASES
+};
+
+#ifdef RAYTRACER_ALLOC_PROFILE
+
+// the allocations of the threads without a phase of their own go to phase,
+// and with thread set, the allocations of the calling thread only
+class AllocPhaseScope
+{
+    public:
+        explicit AllocPhaseScope(AllocPhase phase, bool thread = false);
+        ~AllocPhaseScope();
+
+    private:
+        bool thread;
+        int previous;
+};
+
+// print the allocations of every phase and the busiest call sites to stderr, with the
+// allocations per ray in builds with the statistics and per one of the pixels otherwise
+void print_alloc_profile(uint64_t pixels);
+
+// false, with a message, when RAYTRACER_ALLOC_STRICT=1 and the rows after the first allocated
+bool check_render_allocations();
+
+#define ALLOC_SCOPE_NAME(line) alloc_scope_##line
+#define ALLOC_SCOPE_AT(line, ...) AllocPhaseScope ALLOC_SCOPE_NAME(line)(__VA_ARGS__)
+#define ALLOC_PHASE(...) ALLOC_SCOPE_AT(__LINE__, __VA_ARGS__)
+
+#else
+
+#define ALLOC_PHASE(...) ((void)0)
+
+#endif // RAYTRACER_ALLOC_PROFILE
+
+#endif // SRC_ALLOC_PROFILE_H_
@@ -0,0 +1,497 @@
+/**
+ * @file bench.cpp
+ *
+ * @copyright 2022 Zecheng Qian, All rights reserved.
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <tuple>
+#include "types.h"
+#include "utils.h"
+#include "scene.h"
+#include "ray.h"
+#include "texture.h"
+#include "intersect.h"
+#include "cpu_features.h"
+#include "raylog.h"
+
+// microbenchmarks of the rendering kernels, the results are printed as JSON on stdout
+// usage: ./bench [--warmup N] [--repetitions N] [scene files...]
+//        ./bench [--warmup N] [--repetitions N] --replay rays.log scene_file
+// every synthetic input comes from a fixed seed, so runs of different builds see the same work
+// --replay intersects the rays recorded with RAYTRACER_RAYLOG, see raylog.h, against the scene
+// they were recorded from, without shading, through intersect_check and through each triangle kernel
+
+// seed of the synthetic inputs
+#define BENCH_SEED 2022
+// sizes of the synthetic inputs
+#define BENCH_SPHERES 64
+#define BENCH_TRIANGLES 1024
+#define BENCH_RAYS 20000
+#define BENCH_TEXTURE_SIZE 512
+#define BENCH_SAMPLES 1000000
+
+// the throughput of one benchmark, one sample per repetition
+typedef struct BenchResultType
+{
+    std::string name;
+    std::string unit;
+    size_t items;                // items processed by one repetition
+    std::vector<double> samples; // items per second
+} BenchResult;
+
+// the benchmarked results are added here so the compiler cannot drop the work
+static volatile float sink;
+
+// time body, which processes items items and returns some value depending on all of them
+static BenchResult run_bench(const std::string &name, const std::string &unit, size_t items,
+                             int warmup, int repetitions, const std::function<float()> &body)
+{
+    BenchResult result;
+    result.name = name;
+    result.unit = unit;
+    result.items = items;
+    for (int r = 0; r < warmup; r++)
+    {
+        sink = sink + body();
+    }
+    for (int r = 0; r < repetitions; r++)
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        float value = body();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        sink = sink + value;
+        result.samples.push_back(items / std::max(elapsed.count(), 1e-9));
+    }
+    fprintf(stderr, "%s done\n", name.c_str());
+    return result;
+}
+
+// print the summary statistics of a benchmark as a JSON object
+static void print_result(const BenchResult &result, bool last)
+{
+    std::vector<double> sorted = result.samples;
+    std::sort(sorted.begin(), sorted.end());
+    size_t n = sorted.size();
+    double mean = 0;
+    for (size_t k = 0; k < n; k++)
+    {
+        mean += sorted[k] / n;
+    }
+    double variance = 0;
+    for (size_t k = 0; k < n; k++)
+    {
+        variance += (sorted[k] - mean) * (sorted[k] - mean);
+    }
+    double stddev = n > 1 ? std::sqrt(variance / (n - 1)) : 0;
+    double median = n % 2 == 1 ? sorted[n / 2] : (sorted[n / 2 - 1] + sorted[n / 2]) / 2;
+    printf("    {\"name\": \"%s\", \"unit\": \"%s\", \"items\": %zu, \"mean\": %.6g, \"median\": %.6g, "
+           "\"min\": %.6g, \"max\": %.6g, \"stddev\": %.6g, \"samples\": [",
+           result.name.c_str(), result.unit.c_str(), result.items, mean, median, sorted[0], sorted[n - 1], stddev);
+    for (size_t k = 0; k < result.samples.size(); k++)
+    {
+        printf("%s%.6g", k == 0 ? "" : ", ", result.samples[k]);
+    }
+    printf("]}%s\n", last ? "" : ",");
+}
+
+// the camera, material and light shared by the synthetic scenes
+static void init_synthetic_scene(Scene &scene)
+{
+    scene.setEye(FloatVec3(0, 0, 0));
+    scene.setViewdir(FloatVec3(0, 0, -1));
+    scene.setUpdir(FloatVec3(0, 1, 0));
+    scene.setVfov(60);
+    scene.setWidth(64);
+    scene.setHeight(64);
+    std::vector<MaterialColor> material_list;
+    material_list.push_back(MaterialColor(Color(1, 0.5, 0.2), Color(1, 1, 1), 0.2, 0.6, 0.3, 20, 1, 1));
+    scene.setMaterialList(std::move(material_list));
+    std::vector<Light> light_list;
+    light_list.push_back(Light(3, 4, 0, 1, 1, 1, 1));
+    scene.setLightList(std::move(light_list));
+}
+
+// random spheres in front of the eye
+static void init_sphere_scene(Scene &scene, std::mt19937 &rng)
+{
+    init_synthetic_scene(scene);
+    std::uniform_real_distribution<float> xy(-4, 4), z(-14, -6), radius(0.2f, 1.0f);
+    std::vector<Sphere> sphere_list;
+    for (int k = 0; k < BENCH_SPHERES; k++)
+    {
+        // one draw per statement, the order of evaluation of arguments is unspecified
+        float x = xy(rng);
+        float y = xy(rng);
+        float cz = z(rng);
+        sphere_list.push_back(Sphere(k, 0, -1, -1, FloatVec3(x, y, cz), radius(rng)));
+    }
+    scene.setSphereList(std::move(sphere_list));
+}
+
+// random small triangles in front of the eye
+static void init_triangle_scene(Scene &scene, std::mt19937 &rng)
+{
+    init_synthetic_scene(scene);
+    std::uniform_real_distribution<float> xy(-4, 4), z(-14, -6), offset(-0.8f, 0.8f);
+    std::vector<FloatVec3> vertex_list;
+    std::vector<TriangleVertices> triangle_vertex_list;
+    std::vector<Triangle> triangle_list;
+    for (int k = 0; k < BENCH_TRIANGLES; k++)
+    {
+        float cx = xy(rng);
+        float cy = xy(rng);
+        float cz = z(rng);
+        for (int i = 0; i < 3; i++)
+        {
+            float dx = offset(rng);
+            float dy = offset(rng);
+            float dz = offset(rng);
+            vertex_list.push_back(FloatVec3(cx + dx, cy + dy, cz + dz));
+        }
+        TriangleVertices vertices = {3 * k, 3 * k + 1, 3 * k + 2};
+        triangle_vertex_list.push_back(vertices);
+        triangle_list.push_back(Triangle(0));
+    }
+    scene.setVertexList(std::move(vertex_list));
+    scene.setTriangleVertexList(std::move(triangle_vertex_list));
+    scene.setTriangleList(std::move(triangle_list));
+}
+
+// random rays from around the eye towards the objects
+static std::vector<Ray> random_rays(std::mt19937 &rng)
+{
+    std::uniform_real_distribution<float> origin(-0.5f, 0.5f), spread(-0.45f, 0.45f);
+    std::vector<Ray> rays;
+    for (int k = 0; k < BENCH_RAYS; k++)
+    {
+        float ox = origin(rng);
+        float oy = origin(rng);
+        float dx = spread(rng);
+        float dy = spread(rng);
+        FloatVec3 center(ox, oy, 0);
+        FloatVec3 dir = FloatVec3(dx, dy, -1).normal();
+        rays.push_back(Ray(center, dir));
+    }
+    return rays;
+}
+
+// intersect every ray with the whole scene
+static float intersect_rays(const Scene &scene, const std::vector<Ray> &rays)
+{
+    float sum = 0;
+    for (size_t k = 0; k < rays.size(); k++)
+    {
+        sum += std::get<2>(intersect_check(scene, rays[k], RAY_PRIMARY));
+    }
+    return sum;
+}
+
+// the triangle kernels the host can run, the baseline first
+static std::vector<std::pair<IsaLevel, TriangleKernel> > host_kernels()
+{
+    std::vector<std::pair<IsaLevel, TriangleKernel> > kernels;
+    kernels.push_back(std::make_pair(ISA_BASELINE, intersect_triangles_baseline));
+#if defined(__x86_64__) || defined(__i386__)
+    kernels.push_back(std::make_pair(ISA_SSE42, intersect_triangles_sse42));
+    kernels.push_back(std::make_pair(ISA_AVX2, intersect_triangles_avx2));
+    kernels.push_back(std::make_pair(ISA_AVX512, intersect_triangles_avx512));
+#endif
+    while (!kernels.empty() && kernels.back().first > detect_isa())
+    {
+        kernels.pop_back();
+    }
+    return kernels;
+}
+
+// benchmarks of the rays of a log against the scene they were recorded from
+static bool replay_rays(const std::string &log_file, const std::string &scene_file, int warmup, int repetitions,
+                        std::vector<BenchResult> &results)
+{
+    static const char *categories[RAY_CATEGORIES] = {"primary", "shadow", "reflected", "transmitted", "shadow_relaunch"};
+    std::vector<RayRecord> records;
+    if (!read_ray_log(log_file, records))
+    {
+        return false;
+    }
+    Scene scene;
+    if (scene.parseScene(scene_file) < 7)
+    {
+        fprintf(stderr, "%s is not a complete scene\n", scene_file.c_str());
+        return false;
+    }
+    std::vector<Ray> rays;
+    std::vector<Ray> category_rays[RAY_CATEGORIES];
+    for (size_t k = 0; k < records.size(); k++)
+    {
+        FloatVec3 center(records[k].origin[0], records[k].origin[1], records[k].origin[2]);
+        FloatVec3 dir(records[k].dir[0], records[k].dir[1], records[k].dir[2]);
+        rays.push_back(Ray(center, dir));
+        if (records[k].category < RAY_CATEGORIES)
+        {
+            category_rays[records[k].category].push_back(rays.back());
+        }
+    }
+
+    // the hits must be the ones recorded, or the log belongs to another scene or build
+    size_t differ = 0;
+    for (size_t k = 0; k < rays.size(); k++)
+    {
+        std::tuple<ObjType, int, float> hit = intersect_check(scene, rays[k], RayCategory(records[k].category));
+        if (std::get<0>(hit) != records[k].obj_type || std::get<1>(hit) != records[k].obj_idx || std::get<2>(hit) != records[k].t)
+        {
+            differ++;
+        }
+    }
+    fprintf(stderr, "Replaying %zu rays of %s, %zu hits differ from the log\n", rays.size(), log_file.c_str(), differ);
+
+    results.push_back(run_bench("replay_intersect", "rays/s", rays.size(), warmup, repetitions, [&]() {
+        return intersect_rays(scene, rays);
+    }));
+    for (int c = 0; c < RAY_CATEGORIES; c++)
+    {
+        if (category_rays[c].empty())
+        {
+            continue;
+        }
+        const std::vector<Ray> &subset = category_rays[c];
+        results.push_back(run_bench(std::string("replay_intersect:") + categories[c], "rays/s", subset.size(),
+                                    warmup, repetitions, [&]() {
+            return intersect_rays(scene, subset);
+        }));
+    }
+
+    // the triangles alone through each kernel, checked against the baseline kernel
+    const std::vector<TriangleVertices> &triangles = scene.getTriangleVertexList();
+    const std::vector<FloatVec3> &vertices = scene.getVertexList();
+    if (triangles.empty())
+    {
+        return true;
+    }
+    std::vector<std::pair<IsaLevel, TriangleKernel> > kernels = host_kernels();
+    std::vector<int> baseline_idx(records.size());
+    for (size_t i = 0; i < kernels.size(); i++)
+    {
+        TriangleKernel kernel = kernels[i].second;
+        size_t kernel_differ = 0;
+        for (size_t k = 0; k < records.size(); k++)
+        {
+            float min_t = records[k].tmax;
+            int idx = -1;
+            kernel(triangles.data(), triangles.size(), vertices.data(), records[k].origin, records[k].dir, min_t, idx);
+            if (i == 0)
+            {
+                baseline_idx[k] = idx;
+            }
+            kernel_differ += idx != baseline_idx[k];
+        }
+        if (kernel_differ > 0)
+        {
+            fprintf(stderr, "Warning: the %s kernel hits %zu triangles other than the baseline\n",
+                    isa_name(kernels[i].first), kernel_differ);
+        }
+        std::string name = std::string("replay_triangle_kernel_") + isa_name(kernels[i].first);
+        results.push_back(run_bench(name, "rays/s", records.size(), warmup, repetitions, [&]() {
+            float sum = 0;
+            for (size_t k = 0; k < records.size(); k++)
+            {
+                float min_t = records[k].tmax;
+                int idx = -1;
+                kernel(triangles.data(), triangles.size(), vertices.data(), records[k].origin, records[k].dir, min_t, idx);
+                sum += min_t;
+            }
+            return sum;
+        }));
+    }
+    return true;
+}
+
+// print every result as one JSON document on stdout
+static void print_results(const std::vector<BenchResult> &results, int warmup, int repetitions)
+{
+    printf("{\n  \"seed\": %d,\n  \"isa\": \"%s\",\n  \"warmup\": %d,\n  \"repetitions\": %d,\n  \"benchmarks\": [\n",
+           BENCH_SEED, isa_name(selected_isa()), warmup, repetitions);
+    for (size_t k = 0; k < results.size(); k++)
+    {
+        print_result(results[k], k + 1 == results.size());
+    }
+    printf("  ]\n}\n");
+}
+
+int main(int argc, char **argv)
+{
+    int warmup = 1;
+    int repetitions = 5;
+    std::vector<std::string> scene_files;
+    std::string replay_file;
+    for (int k = 1; k < argc; k++)
+    {
+        if (strcmp(argv[k], "--warmup") == 0 && k + 1 < argc)
+        {
+            warmup = std::max(0, atoi(argv[++k]));
+        }
+        else if (strcmp(argv[k], "--repetitions") == 0 && k + 1 < argc)
+        {
+            repetitions = std::max(1, atoi(argv[++k]));
+        }
+        else if (strcmp(argv[k], "--replay") == 0 && k + 1 < argc)
+        {
+            replay_file = argv[++k];
+        }
+        else
+        {
+            scene_files.push_back(argv[k]);
+        }
+    }
+
+    std::vector<BenchResult> results;
+    if (!replay_file.empty())
+    {
+        if (scene_files.size() != 1)
+        {
+            fprintf(stderr, "--replay needs exactly the scene file the rays were recorded from\n");
+            return 1;
+        }
+        if (!replay_rays(replay_file, scene_files[0], warmup, repetitions, results))
+        {
+            return 1;
+        }
+        print_results(results, warmup, repetitions);
+        return 0;
+    }
+    std::mt19937 rng(BENCH_SEED);
+
+    // sphere tests, nearest hit among all spheres
+    Scene sphere_scene;
+    init_sphere_scene(sphere_scene, rng);
+    std::vector<Ray> rays = random_rays(rng);
+    results.push_back(run_bench("sphere_intersect", "rays/s", rays.size(), warmup, repetitions, [&]() {
+        return intersect_rays(sphere_scene, rays);
+    }));
+
+    // triangle tests, through the dispatched kernel and then each kernel the host can run
+    Scene triangle_scene;
+    init_triangle_scene(triangle_scene, rng);
+    results.push_back(run_bench("triangle_intersect", "rays/s", rays.size(), warmup, repetitions, [&]() {
+        return intersect_rays(triangle_scene, rays);
+    }));
+    std::vector<std::pair<IsaLevel, TriangleKernel> > kernels = host_kernels();
+    for (size_t i = 0; i < kernels.size(); i++)
+    {
+        TriangleKernel kernel = kernels[i].second;
+        const std::vector<TriangleVertices> &triangles = triangle_scene.getTriangleVertexList();
+        const std::vector<FloatVec3> &vertices = triangle_scene.getVertexList();
+        std::string name = std::string("triangle_kernel_") + isa_name(kernels[i].first);
+        results.push_back(run_bench(name, "rays/s", rays.size(), warmup, repetitions, [&]() {
+            float sum = 0;
+            for (size_t k = 0; k < rays.size(); k++)
+            {
+                FloatVec3 c = rays[k].getCenter();
+                FloatVec3 d = rays[k].getDir();
+                float center[3] = {c.first, c.second, c.third};
+                float dir[3] = {d.first, d.second, d.third};
+                float min_t = 100000;
+                int idx = -1;
+                kernel(triangles.data(), triangles.size(), vertices.data(), center, dir, min_t, idx);
+                sum += min_t;
+            }
+            return sum;
+        }));
+    }
+
+    // texture sampling, tri-linear lookups at random coordinates and footprints
+    Texture texture(BENCH_TEXTURE_SIZE, BENCH_TEXTURE_SIZE);
+    for (int j = 0; j < BENCH_TEXTURE_SIZE; j++)
+    {
+        for (int i = 0; i < BENCH_TEXTURE_SIZE; i++)
+        {
+            Rgba8 texel = {uint8_t(i * 7 ^ j * 13), uint8_t(i + j), uint8_t(i * j), 255};
+            texture.getCheckerboard()(i, j) = texel;
+        }
+    }
+    texture.buildMipmap();
+    std::uniform_real_distribution<float> unit(0, 1), footprint(-12, -2);
+    std::vector<float> samples;
+    for (int k = 0; k < BENCH_SAMPLES; k++)
+    {
+        samples.push_back(unit(rng));
+        samples.push_back(unit(rng));
+        samples.push_back(footprint(rng));
+    }
+    results.push_back(run_bench("texture_sample", "samples/s", BENCH_SAMPLES, warmup, repetitions, [&]() {
+        float sum = 0;
+        for (size_t k = 0; k < samples.size(); k += 3)
+        {
+            sum += texture.sample(samples[k], samples[k + 1], samples[k + 2]).getR();
+        }
+        return sum;
+    }));
+
+    // procedural fbm with six octaves, at the same coordinates and footprints
+    Texture fbm(Procedural(Procedural::FBM, 4, 2, Color(0.1, 0.2, 0.6), Color(0.9, 0.9, 0.8), 6));
+    results.push_back(run_bench("procedural_fbm", "samples/s", BENCH_SAMPLES, warmup, repetitions, [&]() {
+        float sum = 0;
+        for (size_t k = 0; k < samples.size(); k += 3)
+        {
+            sum += fbm.sample(samples[k], samples[k + 1], samples[k + 2]).getR();
+        }
+        return sum;
+    }));
+
+    // full shading of the sphere hits, including the shadow rays
+    std::vector<std::tuple<ObjType, int, float> > hits;
+    std::vector<Ray> hit_rays;
+    for (size_t k = 0; k < rays.size(); k++)
+    {
+        std::tuple<ObjType, int, float> hit = intersect_check(sphere_scene, rays[k], RAY_PRIMARY);
+        if (std::get<0>(hit) != OBJ_NONE)
+        {
+            hits.push_back(hit);
+            hit_rays.push_back(rays[k]);
+        }
+    }
+    results.push_back(run_bench("shade", "hits/s", hits.size(), warmup, repetitions, [&]() {
+        float sum = 0;
+        for (size_t k = 0; k < hits.size(); k++)
+        {
+            sum += shade_ray(sphere_scene, std::get<0>(hits[k]), std::get<1>(hits[k]), hit_rays[k], std::get<2>(hits[k])).getR();
+        }
+        return sum;
+    }));
+
+    // end to end, every pixel of each scene file given on the command line
+    for (size_t i = 0; i < scene_files.size(); i++)
+    {
+        Scene scene;
+        if (scene.parseScene(scene_files[i]) < 7)
+        {
+            fprintf(stderr, "Skipping %s, it is not a complete scene\n", scene_files[i].c_str());
+            continue;
+        }
+        ViewWindow viewwindow;
+        view_window_init(scene, viewwindow, 5);
+        size_t pixels = size_t(scene.getWidth()) * scene.getHeight();
+        results.push_back(run_bench("trace_ray:" + scene_files[i], "pixels/s", pixels, warmup, repetitions, [&]() {
+            float sum = 0;
+            for (int h = 0; h < scene.getHeight(); h++)
+            {
+                for (int w = 0; w < scene.getWidth(); w++)
+                {
+                    sum += trace_ray(scene, viewwindow, w, h).getR();
+                }
+            }
+            return sum;
+        }));
+    }
+
+    print_results(results, warmup, repetitions);
+    return 0;
+}
@@ -3,5 +3,78 @@
  *
  * @copyright 2022 Zecheng Qian, All rights reserved.
  */
+#include <algorithm>
 #include "bump.h"
 #include "color.h"
+
+void Bump::buildMipmap()
+{
+    this->mipmap.clear();
+    int level = 0;
+    while (this->getLevel(level).getWidth() > 1 || this->getLevel(level).getHeight() > 1)
+    {
+        const TiledImage<OctNormal> &src = this->getLevel(level);
+        int src_width = src.getWidth();
+        int src_height = src.getHeight();
+        // odd sizes round up so that the last row and column of the source are kept
+        TiledImage<OctNormal> dst((src_width + 1) / 2, (src_height + 1) / 2);
+        for (int j = 0; j < dst.getHeight(); j++)
+        {
+            // two source rows, the last row of an odd size is used twice
+            int j0 = std::min(2 * j, src_height - 1);
+            int j1 = std::min(2 * j + 1, src_height - 1);
+            for (int i = 0; i < dst.getWidth(); i++)
+            {
+                int i0 = std::min(2 * i, src_width - 1);
+                int i1 = std::min(2 * i + 1, src_width - 1);
+                // the encoding renormalizes the average
+                dst(i, j) = OctNormal(src(i0, j0).decode() + src(i1, j0).decode() +
+                                      src(i0, j1).decode() + src(i1, j1).decode());
+            }
+        }
+        this->mipmap.push_back(std::move(dst));
+        level++;
+    }
+}
+
+FloatVec3 Bump::bilinear(int level, float u, float v) const
+{
+    const TiledImage<OctNormal> &checkerboard = this->getLevel(level);
+    int width = checkerboard.getWidth();
+    int height = checkerboard.getHeight();
+    float x = wrap_coordinate(u) * (width - 1);
+    float y = wrap_coordinate(v) * (height - 1);
+    int i = int(x);
+    int j = int(y);
+    float alpha = x - i;
+    float beta = y - j;
+    // clamp the neighbours to the edge of the image
+    int i1 = std::min(i + 1, width - 1);
+    int j1 = std::min(j + 1, height - 1);
+
+    // the four texels usually share one tile, i.e. one cache line
+    return checkerboard(i, j).decode() * ((1 - alpha) * (1 - beta)) +
+           checkerboard(i1, j).decode() * (alpha * (1 - beta)) +
+           checkerboard(i, j1).decode() * ((1 - alpha) * beta) +
+           checkerboard(i1, j1).decode() * (alpha * beta);
+}
+
+FloatVec3 Bump::sample(float u, float v, float lod) const
+{
+    // convert the footprint to texels in the full resolution image
+    float lambda = lod + 0.5 * std::log2(float(this->getWidth()) * this->getHeight());
+    int max_level = this->getLevels() - 1;
+    if (!(lambda > 0) || max_level == 0)
+    {
+        // magnified, or no mipmap
+        return this->bilinear(0, u, v).normal();
+    }
+    if (lambda >= max_level)
+    {
+        return this->bilinear(max_level, u, v).normal();
+    }
+    // blend the two nearest levels
+    int level = int(lambda);
+    float t = lambda - level;
+    return (this->bilinear(level, u, v) * (1 - t) + this->bilinear(level + 1, u, v) * t).normal();
+}
@@ -7,44 +7,72 @@
 #define SRC_BUMP_H_
 
 #include <cstdlib>
+#include <cmath>
+#include <vector>
 #include "types.h"
+#include "image.h"
 
 class Bump
 {
     public:
-        // constructor
-        Bump(int width = 512, int height = 512, int max_val = 255, FloatVec3 **checkerboard = NULL)
+        // constructor, the pixels are only allocated once the real size is known
+        Bump(int width = 0, int height = 0, int max_val = 255)
+            : checkerboard(width, height)
         {
-            this->width = width;
-            this->height = height;
             this->max_val = max_val;
-            // initialize an empty checker board with size w*h
-            this->checkerboard = new FloatVec3 *[width];
-            for (int i = 0; i < width; i++)
-            {
-                this->checkerboard[i] = new FloatVec3[height];
-            }
         }
 
         // getter
-        int getWidth() const { return this->width; }
-        int getHeight() const { return this->height; }
+        int getWidth() const { return this->checkerboard.getWidth(); }
+        int getHeight() const { return this->checkerboard.getHeight(); }
         int getMaxVal() const { return this->max_val; }
-        FloatVec3 **getCheckerboard() const { return this->checkerboard; }
-        const FloatVec3 &getNormal(int i, int j) const { return this->checkerboard[i][j]; }
-        
+        TiledImage<OctNormal> &getCheckerboard() { return this->checkerboard; }
+        const TiledImage<OctNormal> &getCheckerboard() const { return this->checkerboard; }
+        FloatVec3 getNormal(int i, int j) const { return this->checkerboard(i, j).decode(); }
+        // number of mipmap levels, including the full resolution image
+        int getLevels() const { return 1 + this->mipmap.size(); }
+        // level 0 is the full resolution image, each level halves the size of the previous one
+        const TiledImage<OctNormal> &getLevel(int level) const { return level == 0 ? this->checkerboard : this->mipmap[level - 1]; }
+
         // setter
-        void setWidth(int width) { this->width = width; }
-        void setHeight(int height) { this->height = height; }
         void setMaxVal(int max_val) { this->max_val = max_val; }
+        // append a mipmap level, the first one becomes the full resolution image
+        void appendLevel(TiledImage<OctNormal> &&level)
+        {
+            if (this->checkerboard.empty())
+            {
+                this->checkerboard = std::move(level);
+            }
+            else
+            {
+                this->mipmap.push_back(std::move(level));
+            }
+        }
+        // reallocate the image for a new size, the mipmap is dropped
+        void resize(int width, int height)
+        {
+            this->checkerboard.resize(width, height);
+            this->mipmap.clear();
+        }
+
+        // build the mipmap pyramid from the full resolution image
+        // each normal is the renormalized average of a 2x2 block
+        void buildMipmap();
+        // bi-linear interpolation of the normal at texture coordinate (u, v) in one mipmap level,
+        // coordinates outside [0, 1] repeat the normal map
+        FloatVec3 bilinear(int level, float u, float v) const;
+        // tri-linear interpolation of the normal at texture coordinate (u, v), unit length
+        // lod is the log2 of the footprint width in texture coordinate units,
+        // -INFINITY samples the full resolution image
+        FloatVec3 sample(float u, float v, float lod = -INFINITY) const;
 
     private:
-        // size of the texture image
-        int width, height;
         // maximum color value
         int max_val;
-        // dynamically allocate a 2d array to store pixels in the image
-        FloatVec3 **checkerboard;
+        // a tiled image to store octahedral-encoded unit normals
+        TiledImage<OctNormal> checkerboard;
+        // mipmap levels 1, 2, ... down to a single pixel
+        std::vector<TiledImage<OctNormal> > mipmap;
 };
 
 #endif // SRC_BUMP_H_
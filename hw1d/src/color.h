@@ -6,6 +6,8 @@
 #ifndef SRC_COLOR_H_
 #define SRC_COLOR_H_
 
+#include "simd.h"
+
 class Color
 {
     public:
@@ -15,11 +17,20 @@ class Color
         {
         }
 
+        // constructor from the first three lanes of a SIMD vector
+        explicit Color(const Vec4f &v)
+            : r(v.x()), g(v.y()), b(v.z())
+        {
+        }
+
         // getter
         float getR() const { return this->r; }
         float getG() const { return this->g; }
         float getB() const { return this->b; }
 
+        // load into a SIMD vector
+        Vec4f simd() const { return Vec4f(this->r, this->g, this->b); }
+
         // setter
         void setR(float r) { this->r = r; }
         void setG(float g) { this->g = g; }
@@ -0,0 +1,67 @@
+/**
+ * @file cpu_features.cpp
+ *
+ * @copyright 2022 Zecheng Qian, All rights reserved.
+ */
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include "cpu_features.h"
+
+IsaLevel detect_isa()
+{
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+    // also checks that the OS saves the wider registers on context switches
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f"))
+    {
+        return ISA_AVX512;
+    }
+    if (__builtin_cpu_supports("avx2"))
+    {
+        return ISA_AVX2;
+    }
+    if (__builtin_cpu_supports("sse4.2"))
+    {
+        return ISA_SSE42;
+    }
+#endif
+    return ISA_BASELINE;
+}
+
+IsaLevel selected_isa()
+{
+    static const IsaLevel isa = []() {
+        IsaLevel best = detect_isa();
+        const char *env = getenv("RAYTRACER_ISA");
+        if (env == NULL)
+        {
+            return best;
+        }
+        for (int level = ISA_BASELINE; level <= ISA_AVX512; level++)
+        {
+            if (strcmp(env, isa_name(IsaLevel(level))) == 0)
+            {
+                // a level the host lacks would crash on the first kernel call
+                return std::min(best, IsaLevel(level));
+            }
+        }
+        return best;
+    }();
+    return isa;
+}
+
+const char *isa_name(IsaLevel isa)
+{
+    switch (isa)
+    {
+        case ISA_SSE42:
+            return "sse4.2";
+        case ISA_AVX2:
+            return "avx2";
+        case ISA_AVX512:
+            return "avx512";
+        default:
+            return "baseline";
+    }
+}
@@ -0,0 +1,29 @@
+/**
+ * @file cpu_features.h
+ *
+ * @copyright 2022 Zecheng Qian, All rights reserved.
+ */
+#ifndef SRC_CPU_FEATURES_H_
+#define SRC_CPU_FEATURES_H_
+
+// instruction set levels that have their own compiled kernels, in increasing order
+// the baseline is whatever the compiler targets by default, SSE2 on x86-64
+enum IsaLevel
+{
+    ISA_BASELINE,
+    ISA_SSE42,
+    ISA_AVX2,
+    ISA_AVX512
+};
+
+// the best level the host supports, from CPUID
+IsaLevel detect_isa();
+
+// the level the kernels use, detect_isa() by default
+// can be lowered with the RAYTRACER_ISA environment variable (baseline, sse4.2, avx2 or avx512)
+IsaLevel selected_isa();
+
+// printable name of a level
+const char *isa_name(IsaLevel isa);
+
+#endif // SRC_CPU_FEATURES_H_
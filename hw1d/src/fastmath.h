@@ -0,0 +1,224 @@
+/**
+ * @file fastmath.h
+ *
+ * @copyright 2022 Zecheng Qian, All rights reserved.
+ */
+#ifndef SRC_FASTMATH_H_
+#define SRC_FASTMATH_H_
+
+#include "simd.h"
+
+// polynomial approximations of the libm functions used while shading, four lanes at a time
+// each one has a scalar form that runs a single lane
+// the bounds below were measured against the double precision libm over the whole domain,
+// a color channel changes by far less than 1/255 so the output rounds to the same 8-bit value
+// except for values right on a rounding boundary
+
+// 2^k for whole numbers k in [-126, 127], built directly in the exponent bits
+inline Vec4f pow2i(const Vec4f &k)
+{
+#if defined(SIMD_SSE)
+    __m128i e = _mm_add_epi32(_mm_cvttps_epi32(k.v), _mm_set1_epi32(127));
+    return Vec4f(_mm_castsi128_ps(_mm_slli_epi32(e, 23)));
+#elif defined(SIMD_NEON)
+    int32x4_t e = vaddq_s32(vcvtq_s32_f32(k.v), vdupq_n_s32(127));
+    return Vec4f(vreinterpretq_f32_s32(vshlq_n_s32(e, 23)));
+#else
+    Vec4f r;
+    for (int i = 0; i < 4; i++)
+    {
+        uint32_t bits = uint32_t(int(k.v[i]) + 127) << 23;
+        memcpy(&r.v[i], &bits, sizeof(bits));
+    }
+    return r;
+#endif
+}
+
+// split positive normal floats into x = m * 2^e with m in [1, 2), e is returned as a float
+inline Vec4f split_exponent(const Vec4f &x, Vec4f &e)
+{
+#if defined(SIMD_SSE)
+    __m128i bits = _mm_castps_si128(x.v);
+    e = Vec4f(_mm_cvtepi32_ps(_mm_sub_epi32(_mm_srli_epi32(bits, 23), _mm_set1_epi32(127))));
+    bits = _mm_or_si128(_mm_and_si128(bits, _mm_set1_epi32(0x007fffff)), _mm_set1_epi32(0x3f800000));
+    return Vec4f(_mm_castsi128_ps(bits));
+#elif defined(SIMD_NEON)
+    uint32x4_t bits = vreinterpretq_u32_f32(x.v);
+    int32x4_t exponent = vsubq_s32(vreinterpretq_s32_u32(vshrq_n_u32(bits, 23)), vdupq_n_s32(127));
+    e = Vec4f(vcvtq_f32_s32(exponent));
+    bits = vorrq_u32(vandq_u32(bits, vdupq_n_u32(0x007fffff)), vdupq_n_u32(0x3f800000));
+    return Vec4f(vreinterpretq_f32_u32(bits));
+#else
+    Vec4f m;
+    for (int i = 0; i < 4; i++)
+    {
+        uint32_t bits;
+        memcpy(&bits, &x.v[i], sizeof(bits));
+        e.v[i] = float(int(bits >> 23) - 127);
+        bits = (bits & 0x007fffff) | 0x3f800000;
+        memcpy(&m.v[i], &bits, sizeof(bits));
+    }
+    return m;
+#endif
+}
+
+// round down to a whole number
+inline Vec4f floor(const Vec4f &x)
+{
+    Vec4f t = trunc(x);
+    return select(less(x, t), t - Vec4f::splat(1), t);
+}
+
+// 2^x, relative error below 1.5e-7, clamped to the normal range so it never returns inf
+inline Vec4f fast_exp2(const Vec4f &x)
+{
+    Vec4f xc = min(max(x, Vec4f::splat(-126)), Vec4f::splat(127));
+    // 2^x = 2^k * 2^f with f in [-0.5, 0.5]
+    Vec4f k = floor(xc + Vec4f::splat(0.5f));
+    Vec4f f = xc - k;
+    Vec4f p = Vec4f::splat(1.535336188319500e-4f);
+    p = p * f + Vec4f::splat(1.339887440266574e-3f);
+    p = p * f + Vec4f::splat(9.618437357674640e-3f);
+    p = p * f + Vec4f::splat(5.550332471162809e-2f);
+    p = p * f + Vec4f::splat(2.402264791363012e-1f);
+    p = p * f + Vec4f::splat(6.931472028550421e-1f);
+    return (p * f + Vec4f::splat(1)) * pow2i(k);
+}
+
+// log2(x) for positive normal x, error below 1e-7, absolute up to 1 and relative beyond
+inline Vec4f fast_log2(const Vec4f &x)
+{
+    Vec4f e;
+    Vec4f m = split_exponent(x, e);
+    // move m into [sqrt(1/2), sqrt(2)] so the series is centered on 1
+    Vec4f big = less(Vec4f::splat(1.41421356f), m);
+    m = select(big, m * 0.5f, m);
+    e = select(big, e + Vec4f::splat(1), e);
+    Vec4f z = m - Vec4f::splat(1);
+    Vec4f z2 = z * z;
+    Vec4f p = Vec4f::splat(7.0376836292e-2f);
+    p = p * z - Vec4f::splat(1.1514610310e-1f);
+    p = p * z + Vec4f::splat(1.1676998740e-1f);
+    p = p * z - Vec4f::splat(1.2420140846e-1f);
+    p = p * z + Vec4f::splat(1.4249322787e-1f);
+    p = p * z - Vec4f::splat(1.6668057665e-1f);
+    p = p * z + Vec4f::splat(2.0000714765e-1f);
+    p = p * z - Vec4f::splat(2.4999993993e-1f);
+    p = p * z + Vec4f::splat(3.3333331174e-1f);
+    // ln(1 + z) = z + y, converted with log2(e) = 1 + 0.44269504 so the large part stays exact
+    Vec4f y = p * z * z2 - z2 * 0.5f;
+    Vec4f log2e_minus_1 = Vec4f::splat(0.44269504088896340736f);
+    return (y * log2e_minus_1 + z * log2e_minus_1 + y) + z + e;
+}
+
+// x^y for x >= 0 and y >= 0, as 2^(y log2 x)
+// the error grows with |y log2 x|, it stays below 2e-7 of the result while that is below 1,
+// and below 1e-7 in absolute terms for any result in [0, 1]
+inline Vec4f fast_pow(const Vec4f &x, const Vec4f &y)
+{
+    Vec4f zero;
+    Vec4f r = fast_exp2(y * fast_log2(x));
+    // 0^y is 0, except 0^0 which is 1
+    Vec4f at_zero = select(less(zero, y), zero, Vec4f::splat(1));
+    return select(less(zero, x), r, at_zero);
+}
+
+// e^x, relative error below 1.5e-7 for |x| < 1 and below 1.5e-7 * |x| beyond, clamped below -87
+inline Vec4f fast_exp(const Vec4f &x)
+{
+    return fast_exp2(x * 1.44269504088896340736f);
+}
+
+// atan(t) for t in [0, 1]
+inline Vec4f atan_unit(const Vec4f &t)
+{
+    // fold [tan(pi/8), 1] onto [-tan(pi/8), 0] with atan(t) = pi/4 + atan((t - 1) / (t + 1))
+    Vec4f one = Vec4f::splat(1);
+    Vec4f folded = less(Vec4f::splat(0.41421356f), t);
+    Vec4f s = select(folded, (t - one) / (t + one), t);
+    Vec4f z = s * s;
+    Vec4f p = Vec4f::splat(8.05374449538e-2f);
+    p = p * z - Vec4f::splat(1.38776856032e-1f);
+    p = p * z + Vec4f::splat(1.99777106478e-1f);
+    p = p * z - Vec4f::splat(3.33329491539e-1f);
+    Vec4f r = p * z * s + s;
+    return select(folded, r + Vec4f::splat(0.78539816339744830962f), r);
+}
+
+// atan2(y, x) in [-pi, pi], absolute error below 3e-7, 0 when both are 0
+inline Vec4f fast_atan2(const Vec4f &y, const Vec4f &x)
+{
+    Vec4f zero;
+    Vec4f ax = abs(x), ay = abs(y);
+    Vec4f steep = less(ax, ay);
+    Vec4f hi = max(ax, ay);
+    Vec4f t = select(less(zero, hi), min(ax, ay) / hi, zero);
+    Vec4f r = atan_unit(t);
+    // undo the folding onto the first half quadrant
+    r = select(steep, Vec4f::splat(1.57079632679489661923f) - r, r);
+    r = select(less(x, zero), Vec4f::splat(3.14159265358979323846f) - r, r);
+    return select(less(y, zero), -r, r);
+}
+
+// acos(x) for x in [-1, 1], absolute error below 3.5e-7
+inline Vec4f fast_acos(const Vec4f &x)
+{
+    Vec4f one = Vec4f::splat(1);
+    Vec4f half = Vec4f::splat(0.5f);
+    Vec4f a = min(abs(x), one);
+    // near 1 use acos(a) = 2 asin(sqrt((1 - a) / 2)), so the series argument stays below 1/2
+    Vec4f wide = less(half, a);
+    Vec4f s = select(wide, sqrt((one - a) * half), a);
+    Vec4f z = s * s;
+    Vec4f p = Vec4f::splat(4.2163199048e-2f);
+    p = p * z + Vec4f::splat(2.4181311049e-2f);
+    p = p * z + Vec4f::splat(4.5470025998e-2f);
+    p = p * z + Vec4f::splat(7.4953002686e-2f);
+    p = p * z + Vec4f::splat(1.6666752422e-1f);
+    Vec4f asin_s = p * z * s + s;
+    Vec4f r = select(wide, asin_s + asin_s, Vec4f::splat(1.57079632679489661923f) - asin_s);
+    return select(less(x, Vec4f()), Vec4f::splat(3.14159265358979323846f) - r, r);
+}
+
+// scalar forms, one lane of the vector code
+inline float fast_exp2(float x) { return fast_exp2(Vec4f::splat(x)).x(); }
+inline float fast_log2(float x) { return fast_log2(Vec4f::splat(x)).x(); }
+inline float fast_pow(float x, float y) { return fast_pow(Vec4f::splat(x), Vec4f::splat(y)).x(); }
+inline float fast_exp(float x) { return fast_exp(Vec4f::splat(x)).x(); }
+inline float fast_atan2(float y, float x) { return fast_atan2(Vec4f::splat(y), Vec4f::splat(x)).x(); }
+inline float fast_acos(float x) { return fast_acos(Vec4f::splat(x)).x(); }
+
+// x^N for an exponent known at compile time, by repeated squaring
+template <int N>
+inline float ipow(float x)
+{
+    return (N % 2 == 1 ? x : 1.0f) * ipow<N / 2>(x * x);
+}
+
+template <>
+inline float ipow<0>(float)
+{
+    return 1;
+}
+
+template <>
+inline float ipow<1>(float x)
+{
+    return x;
+}
+
+// x^n for a whole exponent n >= 0 known only at run time
+inline float powi(float x, int n)
+{
+    float r = 1;
+    for (; n > 0; n >>= 1, x *= x)
+    {
+        if (n & 1)
+        {
+            r *= x;
+        }
+    }
+    return r;
+}
+
+#endif // SRC_FASTMATH_H_
@@ -0,0 +1,130 @@
+/**
+ * @file heatmap.cpp
+ *
+ * @copyright 2022 Zecheng Qian, All rights reserved.
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+#include <chrono>
+#include <cmath>
+#include <algorithm>
+#include <vector>
+#include "heatmap.h"
+#include "stats.h"
+#include "utils.h"
+
+HeatmapMode heatmap_mode()
+{
+    const char *env = getenv("RAYTRACER_HEATMAP");
+    if (env == NULL || env[0] == '\0')
+    {
+        return HEATMAP_NONE;
+    }
+    std::string name(env);
+    if (name == "time")
+    {
+        return HEATMAP_TIME;
+    }
+    if (name == "tests" || name == "rays")
+    {
+#ifdef RAYTRACER_STATS
+        return name == "tests" ? HEATMAP_TESTS : HEATMAP_RAYS;
+#else
+        fprintf(stderr, "RAYTRACER_HEATMAP=%s needs a build with make STATS=1, measuring time instead\n", env);
+        return HEATMAP_TIME;
+#endif
+    }
+    fprintf(stderr, "Unknown RAYTRACER_HEATMAP %s, expected time, tests or rays\n", env);
+    return HEATMAP_NONE;
+}
+
+double heatmap_counter(HeatmapMode mode)
+{
+#ifdef RAYTRACER_STATS
+    if (mode == HEATMAP_TESTS || mode == HEATMAP_RAYS)
+    {
+        const RayStats &stats = thread_stats();
+        uint64_t total = 0;
+        for (int c = 0; c < RAY_CATEGORIES; c++)
+        {
+            total += mode == HEATMAP_RAYS ? stats.rays[c] : stats.sphere_tests[c] + stats.triangle_tests[c];
+        }
+        return double(total);
+    }
+#endif
+    std::chrono::duration<double> now = std::chrono::steady_clock::now().time_since_epoch();
+    return now.count();
+}
+
+// false colour of t in [0, 1], black through blue, red and yellow to white
+static Color false_colour(float t)
+{
+    static const float stops[5][3] = {{0, 0, 0}, {0.1f, 0.1f, 0.6f}, {0.8f, 0.1f, 0.3f}, {1, 0.8f, 0}, {1, 1, 1}};
+    t = std::min(1.0f, std::max(0.0f, t)) * 4;
+    int k = std::min(3, int(t));
+    float f = t - k;
+    return Color(stops[k][0] + (stops[k + 1][0] - stops[k][0]) * f,
+                 stops[k][1] + (stops[k + 1][1] - stops[k][1]) * f,
+                 stops[k][2] + (stops[k + 1][2] - stops[k][2]) * f);
+}
+
+void write_heatmap(const std::string &filename, const Image<float> &cost, HeatmapMode mode)
+{
+    static const char *names[] = {"", "time", "tests", "rays"};
+    static const char *units[] = {"", " s", "", ""};
+    int width = cost.getWidth();
+    int height = cost.getHeight();
+    // the range of the positive costs, a pixel can cost 100 times another so the scale is logarithmic
+    // the colours top out at the 99.5th percentile, a few pixels interrupted by the system would
+    // otherwise squeeze everything else into the dark end
+    std::vector<float> positive;
+    for (size_t k = 0; k < cost.size(); k++)
+    {
+        if (cost.data()[k] > 0)
+        {
+            positive.push_back(cost.data()[k]);
+        }
+    }
+    float low = 0, high = 0, top = 0;
+    if (!positive.empty())
+    {
+        low = *std::min_element(positive.begin(), positive.end());
+        high = *std::max_element(positive.begin(), positive.end());
+        std::vector<float>::iterator nth = positive.begin() + size_t(0.995 * (positive.size() - 1));
+        std::nth_element(positive.begin(), nth, positive.end());
+        top = *nth;
+    }
+    float range = top > low ? std::log(top / low) : 1;
+    Image<Color> colours(width, height);
+    for (int j = 0; j < height; j++)
+    {
+        for (int i = 0; i < width; i++)
+        {
+            float c = cost(i, j);
+            colours(i, j) = false_colour(c > 0 ? std::log(c / low) / range : 0);
+        }
+    }
+    output_image(filename + ".heatmap.ppm", colours, width, height);
+
+    // portable float map, one channel, rows from the bottom up, a negative scale means little endian
+    std::string raw = filename + ".heatmap.pfm";
+    FILE *file = fopen(raw.c_str(), "wb");
+    if (file == NULL)
+    {
+        fprintf(stderr, "Could not open output stream with file %s\n", raw.c_str());
+        return;
+    }
+    uint16_t probe = 1;
+    uint8_t first;
+    memcpy(&first, &probe, 1);
+    fprintf(file, "Pf\n%d %d\n%s\n", width, height, first == 1 ? "-1.0" : "1.0");
+    for (int j = height - 1; j >= 0; j--)
+    {
+        fwrite(cost.row(j), sizeof(float), width, file);
+    }
+    fclose(file);
+    fprintf(stderr, "Per-pixel %s from %g to %g%s, written to %s.heatmap.ppm and .pfm\n",
+            names[mode], low, high, units[mode], filename.c_str());
+}
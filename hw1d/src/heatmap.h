@@ -0,0 +1,33 @@
+/**
+ * @file heatmap.h
+ *
+ * @copyright 2022 Zecheng Qian, All rights reserved.
+ */
+#ifndef SRC_HEATMAP_H_
+#define SRC_HEATMAP_H_
+
+#include <string>
+#include "image.h"
+
+// what the per-pixel cost heatmap measures
+enum HeatmapMode
+{
+    HEATMAP_NONE,
+    HEATMAP_TIME,  // wall time in seconds
+    HEATMAP_TESTS, // sphere and triangle tests
+    HEATMAP_RAYS   // rays of every category
+};
+
+// the mode chosen with the RAYTRACER_HEATMAP environment variable: time, tests or rays
+// tests and rays come from the counters in stats.h, without them the mode falls back to time
+HeatmapMode heatmap_mode();
+
+// a running total of the measured cost on the calling thread,
+// the cost of a pixel is the difference before and after tracing it
+double heatmap_counter(HeatmapMode mode);
+
+// write the costs next to the image as filename.heatmap.ppm, in false colour on a log scale,
+// and as raw floats in filename.heatmap.pfm
+void write_heatmap(const std::string &filename, const Image<float> &cost, HeatmapMode mode);
+
+#endif // SRC_HEATMAP_H_
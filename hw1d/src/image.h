@@ -0,0 +1,221 @@
+/**
+ * @file image.h
+ *
+ * @copyright 2022 Zecheng Qian, All rights reserved.
+ */
+#ifndef SRC_IMAGE_H_
+#define SRC_IMAGE_H_
+
+#include <cstdlib>
+#include <cstddef>
+#include <new>
+#include <algorithm>
+#include <cmath>
+
+// alignment of the pixel storage, one cache line
+#define IMAGE_ALIGNMENT 64
+
+// a 2d image stored in one contiguous, aligned, row-major block
+// pixel (i, j) is column i and row j, the same convention as the old Color** arrays
+template <typename T>
+class Image
+{
+    public:
+        // constructor, an empty image does not allocate anything
+        Image(int width = 0, int height = 0)
+            : width(0), height(0), pixels(NULL)
+        {
+            this->resize(width, height);
+        }
+
+        // copy constructor, deep copy the pixels
+        Image(const Image &image)
+            : width(0), height(0), pixels(NULL)
+        {
+            this->resize(image.width, image.height);
+            std::copy(image.pixels, image.pixels + image.size(), this->pixels);
+        }
+
+        // move constructor, steal the pixels
+        Image(Image &&image) noexcept
+            : width(image.width), height(image.height), pixels(image.pixels)
+        {
+            image.width = 0;
+            image.height = 0;
+            image.pixels = NULL;
+        }
+
+        // destructor
+        ~Image() { this->release(); }
+
+        // copy assignment
+        Image &operator=(const Image &image)
+        {
+            if (this != &image)
+            {
+                this->resize(image.width, image.height);
+                std::copy(image.pixels, image.pixels + image.size(), this->pixels);
+            }
+            return *this;
+        }
+
+        // move assignment
+        Image &operator=(Image &&image) noexcept
+        {
+            if (this != &image)
+            {
+                this->release();
+                this->width = image.width;
+                this->height = image.height;
+                this->pixels = image.pixels;
+                image.width = 0;
+                image.height = 0;
+                image.pixels = NULL;
+            }
+            return *this;
+        }
+
+        // getter
+        int getWidth() const { return this->width; }
+        int getHeight() const { return this->height; }
+        size_t size() const { return size_t(this->width) * this->height; }
+        bool empty() const { return this->pixels == NULL; }
+        T *data() { return this->pixels; }
+        const T *data() const { return this->pixels; }
+        // start of row j
+        T *row(int j) { return this->pixels + size_t(j) * this->width; }
+        const T *row(int j) const { return this->pixels + size_t(j) * this->width; }
+
+        // access pixel at column i, row j
+        T &operator()(int i, int j) { return this->pixels[size_t(j) * this->width + i]; }
+        const T &operator()(int i, int j) const { return this->pixels[size_t(j) * this->width + i]; }
+
+        // reallocate the storage for a new size, old pixels are discarded
+        void resize(int width, int height)
+        {
+            if (width == this->width && height == this->height)
+            {
+                return;
+            }
+            this->release();
+            if (width <= 0 || height <= 0)
+            {
+                return;
+            }
+            void *block = NULL;
+            size_t bytes = size_t(width) * height * sizeof(T);
+            if (posix_memalign(&block, IMAGE_ALIGNMENT, bytes) != 0)
+            {
+                throw std::bad_alloc();
+            }
+            this->pixels = static_cast<T *>(block);
+            // default construct every pixel in place
+            for (size_t k = 0; k < size_t(width) * height; k++)
+            {
+                new (this->pixels + k) T();
+            }
+            this->width = width;
+            this->height = height;
+        }
+
+    private:
+        // free the storage
+        void release()
+        {
+            if (this->pixels != NULL)
+            {
+                for (size_t k = 0; k < this->size(); k++)
+                {
+                    this->pixels[k].~T();
+                }
+                free(this->pixels);
+            }
+            this->width = 0;
+            this->height = 0;
+            this->pixels = NULL;
+        }
+
+        // size of the image
+        int width, height;
+        // row-major pixel storage
+        T *pixels;
+};
+
+// side of the square tiles of TiledImage, 4x4 pixels
+#define TILE_SHIFT 2
+#define TILE_SIZE (1 << TILE_SHIFT)
+#define TILE_MASK (TILE_SIZE - 1)
+
+// a 2d image stored in 4x4 tiles, each tile is contiguous and the tiles are in row-major order
+// with 4-byte pixels a tile fills exactly one cache line, so the 2x2 footprint of a
+// bi-linear lookup usually falls in a single line whichever direction the sampling moves
+// the size is padded up to whole tiles
+template <typename T>
+class TiledImage
+{
+    public:
+        // constructor, an empty image does not allocate anything
+        TiledImage(int width = 0, int height = 0)
+        {
+            this->resize(width, height);
+        }
+
+        // getter
+        int getWidth() const { return this->width; }
+        int getHeight() const { return this->height; }
+        size_t size() const { return size_t(this->width) * this->height; }
+        bool empty() const { return this->tiles.empty(); }
+        // raw tile storage, including the padding of partial tiles
+        T *data() { return this->tiles.data(); }
+        const T *data() const { return this->tiles.data(); }
+        size_t capacity() const { return this->tiles.size(); }
+
+        // access pixel at column i, row j
+        T &operator()(int i, int j) { return this->tiles.data()[this->address(i, j)]; }
+        const T &operator()(int i, int j) const { return this->tiles.data()[this->address(i, j)]; }
+
+        // swizzled address of pixel (i, j): the tile index, then the position inside the tile
+        size_t address(int i, int j) const
+        {
+            size_t tile = size_t(j >> TILE_SHIFT) * this->tiles_x + (i >> TILE_SHIFT);
+            return (tile << (2 * TILE_SHIFT)) + ((j & TILE_MASK) << TILE_SHIFT) + (i & TILE_MASK);
+        }
+
+        // reallocate the storage for a new size, old pixels are discarded
+        void resize(int width, int height)
+        {
+            this->width = std::max(0, width);
+            this->height = std::max(0, height);
+            this->tiles_x = (this->width + TILE_MASK) >> TILE_SHIFT;
+            this->tiles_y = (this->height + TILE_MASK) >> TILE_SHIFT;
+            // one row of the underlying image per tile
+            this->tiles.resize(TILE_SIZE * TILE_SIZE, this->tiles_x * this->tiles_y);
+        }
+
+    private:
+        // size of the image
+        int width, height;
+        // number of tiles in each direction
+        int tiles_x, tiles_y;
+        // tile storage, aligned so that every tile starts a new cache line
+        Image<T> tiles;
+};
+
+// bring a texture coordinate into [0, 1] with repeat semantics, so tiled uvs such as the
+// 0 - 4 range of some obj files wrap around, coordinates already in [0, 1] are left alone
+// and NaN becomes 0
+inline float wrap_coordinate(float u)
+{
+    if (u >= 0 && u <= 1)
+    {
+        return u;
+    }
+    if (!std::isfinite(u))
+    {
+        return 0;
+    }
+    // u - floor(u) rounds to 1 for tiny negative u, which is still in range
+    return u - std::floor(u);
+}
+
+#endif // SRC_IMAGE_H_
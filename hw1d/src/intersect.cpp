@@ -0,0 +1,101 @@
+/**
+ * @file intersect.cpp
+ *
+ * @copyright 2022 Zecheng Qian, All rights reserved.
+ */
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include "intersect.h"
+#include "cpu_features.h"
+
+void intersect_triangles_baseline(const TriangleVertices *triangles, size_t count, const FloatVec3 *vertices,
+                                  const float *center, const float *dir, float &min_t, int &obj_idx)
+{
+    float D;
+    float ray_t;
+    float determinant;
+    Vec4f ray_center(center[0], center[1], center[2]);
+    Vec4f ray_dir(dir[0], dir[1], dir[2]);
+    for (size_t k = 0; k < count; k++)
+    {
+        const TriangleVertices &t = triangles[k];
+        // parameters for the plane equation n.x + D = 0
+        Vec4f p0 = vertices[t.v0].simd();
+        Vec4f e1 = vertices[t.v1].simd() - p0;
+        Vec4f e2 = vertices[t.v2].simd() - p0;
+        Vec4f n = normalize3_fast(cross3(e1, e2));
+        D = -dot3(n, p0);
+        determinant = dot3(n, ray_dir);
+        // test whether the ray is parallel with the plane
+        if (std::abs(determinant) < 1e-6)
+        {
+            // in the case that the ray is parallel to the plane
+            continue;
+        }
+        ray_t = -(dot3(n, ray_center) + D) / determinant;
+        if (ray_t < 0)
+        {
+            // no intersection
+            continue;
+        }
+        // get the intersection point p, and its barycentric coordinates
+        Vec4f ep = ray_center + ray_dir * ray_t - p0;
+        float d11 = dot3(e1, e1);
+        float d12 = dot3(e1, e2);
+        float d22 = dot3(e2, e2);
+        float dp1 = dot3(ep, e1);
+        float dp2 = dot3(ep, e2);
+        float det = d11 * d22 - d12 * d12;
+        float beta = (d22 * dp1 - d12 * dp2) / det;
+        float gamma = (d11 * dp2 - d12 * dp1) / det;
+        float alpha = 1 - beta - gamma;
+        // test whether the intersection point is inside the triangle or not
+        if (alpha > -1e-6 && alpha < 1 && beta > -1e-6 && beta < 1 && gamma > -1e-6 && gamma < 1)
+        {
+            // in the triangle
+            if (ray_t < min_t && ray_t > 1e-3)
+            {
+                min_t = ray_t;
+                obj_idx = k;
+            }
+        }
+    }
+}
+
+// pick the kernel once, and say which one when comparing levels or in statistics builds,
+// so a slow run can be told apart from a missing ISA without every render printing it
+static TriangleKernel select_triangle_kernel()
+{
+    IsaLevel isa = selected_isa();
+    bool report = getenv("RAYTRACER_ISA") != NULL;
+#ifdef RAYTRACER_STATS
+    report = true;
+#endif
+    if (report)
+    {
+        fprintf(stderr, "Using the %s triangle intersection kernel\n", isa_name(isa));
+    }
+    switch (isa)
+    {
+#if defined(__x86_64__) || defined(__i386__)
+        case ISA_AVX512:
+            return intersect_triangles_avx512;
+        case ISA_AVX2:
+            return intersect_triangles_avx2;
+        case ISA_SSE42:
+            return intersect_triangles_sse42;
+#endif
+        default:
+            return intersect_triangles_baseline;
+    }
+}
+
+void intersect_triangles(const TriangleVertices *triangles, size_t count, const FloatVec3 *vertices,
+                         const Vec4f &center, const Vec4f &dir, float &min_t, int &obj_idx)
+{
+    static const TriangleKernel kernel = select_triangle_kernel();
+    float c[3] = {center.x(), center.y(), center.z()};
+    float d[3] = {dir.x(), dir.y(), dir.z()};
+    kernel(triangles, count, vertices, c, d, min_t, obj_idx);
+}
@@ -0,0 +1,31 @@
+/**
+ * @file intersect.h
+ *
+ * @copyright 2022 Zecheng Qian, All rights reserved.
+ */
+#ifndef SRC_INTERSECT_H_
+#define SRC_INTERSECT_H_
+
+#include <cstddef>
+#include "types.h"
+
+// find the nearest of count triangles hit by the ray from center along dir
+// a hit counts only when it is nearer than min_t and further than 1e-3, then min_t and obj_idx are updated
+// the kernel is compiled once per instruction set level, the one for selected_isa() is used
+void intersect_triangles(const TriangleVertices *triangles, size_t count, const FloatVec3 *vertices,
+                         const Vec4f &center, const Vec4f &dir, float &min_t, int &obj_idx);
+
+// the kernel for each level, all of them give exactly the same hits
+// center and dir point to three floats, the wide kernels only exist on x86
+typedef void (*TriangleKernel)(const TriangleVertices *triangles, size_t count, const FloatVec3 *vertices,
+                               const float *center, const float *dir, float &min_t, int &obj_idx);
+void intersect_triangles_baseline(const TriangleVertices *triangles, size_t count, const FloatVec3 *vertices,
+                                  const float *center, const float *dir, float &min_t, int &obj_idx);
+void intersect_triangles_sse42(const TriangleVertices *triangles, size_t count, const FloatVec3 *vertices,
+                               const float *center, const float *dir, float &min_t, int &obj_idx);
+void intersect_triangles_avx2(const TriangleVertices *triangles, size_t count, const FloatVec3 *vertices,
+                              const float *center, const float *dir, float &min_t, int &obj_idx);
+void intersect_triangles_avx512(const TriangleVertices *triangles, size_t count, const FloatVec3 *vertices,
+                                const float *center, const float *dir, float &min_t, int &obj_idx);
+
+#endif // SRC_INTERSECT_H_
@@ -0,0 +1,47 @@
+/**
+ * @file intersect_avx2.cpp
+ *
+ * @copyright 2022 Zecheng Qian, All rights reserved.
+ */
+#include <immintrin.h>
+#include "intersect_kernel.h"
+
+namespace
+{
+// eight floats in an AVX register
+struct Pack8
+{
+    static const int WIDTH = 8;
+    __m256 v;
+
+    // lane mask from a comparison
+    struct Mask
+    {
+        __m256 m;
+        Mask operator&(const Mask &a) const { return Mask{_mm256_and_ps(this->m, a.m)}; }
+        unsigned bits() const { return unsigned(_mm256_movemask_ps(this->m)); }
+    };
+
+    static Pack8 splat(float c) { return Pack8{_mm256_set1_ps(c)}; }
+    static Pack8 load(const float *p) { return Pack8{_mm256_load_ps(p)}; }
+    void store(float *p) const { _mm256_store_ps(p, this->v); }
+
+    Pack8 operator+(const Pack8 &a) const { return Pack8{_mm256_add_ps(this->v, a.v)}; }
+    Pack8 operator-(const Pack8 &a) const { return Pack8{_mm256_sub_ps(this->v, a.v)}; }
+    Pack8 operator*(const Pack8 &a) const { return Pack8{_mm256_mul_ps(this->v, a.v)}; }
+    Pack8 operator/(const Pack8 &a) const { return Pack8{_mm256_div_ps(this->v, a.v)}; }
+    Pack8 operator-() const { return Pack8{_mm256_xor_ps(this->v, _mm256_set1_ps(-0.0f))}; }
+    Mask operator<(const Pack8 &a) const { return Mask{_mm256_cmp_ps(this->v, a.v, _CMP_LT_OQ)}; }
+    Mask operator>=(const Pack8 &a) const { return Mask{_mm256_cmp_ps(this->v, a.v, _CMP_GE_OQ)}; }
+
+    static Pack8 abs(const Pack8 &a) { return Pack8{_mm256_andnot_ps(_mm256_set1_ps(-0.0f), a.v)}; }
+    // the same estimate as the SSE rsqrtps, so the normals match the other kernels
+    static Pack8 rsqrt(const Pack8 &a) { return Pack8{_mm256_rsqrt_ps(a.v)}; }
+};
+} // namespace
+
+void intersect_triangles_avx2(const TriangleVertices *triangles, size_t count, const FloatVec3 *vertices,
+                              const float *center, const float *dir, float &min_t, int &obj_idx)
+{
+    intersect_triangles_wide<Pack8>(triangles, count, vertices, center, dir, min_t, obj_idx);
+}
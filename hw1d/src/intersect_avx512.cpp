@@ -0,0 +1,63 @@
+/**
+ * @file intersect_avx512.cpp
+ *
+ * @copyright 2022 Zecheng Qian, All rights reserved.
+ */
+#include <immintrin.h>
+#include "intersect_kernel.h"
+
+namespace
+{
+// sixteen floats in an AVX-512 register, only AVX-512F instructions are used
+struct Pack16
+{
+    static const int WIDTH = 16;
+    __m512 v;
+
+    // lane mask from a comparison, held in a mask register
+    struct Mask
+    {
+        __mmask16 m;
+        Mask operator&(const Mask &a) const { return Mask{__mmask16(this->m & a.m)}; }
+        unsigned bits() const { return unsigned(this->m); }
+    };
+
+    static Pack16 splat(float c) { return Pack16{_mm512_set1_ps(c)}; }
+    static Pack16 load(const float *p) { return Pack16{_mm512_load_ps(p)}; }
+    void store(float *p) const { _mm512_store_ps(p, this->v); }
+
+    Pack16 operator+(const Pack16 &a) const { return Pack16{_mm512_add_ps(this->v, a.v)}; }
+    Pack16 operator-(const Pack16 &a) const { return Pack16{_mm512_sub_ps(this->v, a.v)}; }
+    Pack16 operator*(const Pack16 &a) const { return Pack16{_mm512_mul_ps(this->v, a.v)}; }
+    Pack16 operator/(const Pack16 &a) const { return Pack16{_mm512_div_ps(this->v, a.v)}; }
+    Pack16 operator-() const
+    {
+        // the float xor needs AVX-512DQ, flip the sign bit as integers instead
+        __m512i sign = _mm512_set1_epi32(int(0x80000000u));
+        return Pack16{_mm512_castsi512_ps(_mm512_xor_si512(_mm512_castps_si512(this->v), sign))};
+    }
+    Mask operator<(const Pack16 &a) const { return Mask{_mm512_cmp_ps_mask(this->v, a.v, _CMP_LT_OQ)}; }
+    Mask operator>=(const Pack16 &a) const { return Mask{_mm512_cmp_ps_mask(this->v, a.v, _CMP_GE_OQ)}; }
+
+    static Pack16 abs(const Pack16 &a) { return Pack16{_mm512_abs_ps(a.v)}; }
+    // rsqrt14 is more precise than the SSE estimate and would change the normals,
+    // so the 8-lane estimate is applied to each half
+    static Pack16 rsqrt(const Pack16 &a)
+    {
+        // the masked forms with a zero source avoid a false uninitialized warning from GCC's headers
+        __m512d wide = _mm512_castps_pd(a.v);
+        __m256d zero = _mm256_setzero_pd();
+        __m256 low = _mm256_rsqrt_ps(_mm256_castpd_ps(_mm512_mask_extractf64x4_pd(zero, 0xF, wide, 0)));
+        __m256 high = _mm256_rsqrt_ps(_mm256_castpd_ps(_mm512_mask_extractf64x4_pd(zero, 0xF, wide, 1)));
+        __m512d both = _mm512_mask_insertf64x4(_mm512_setzero_pd(), 0xFF, _mm512_setzero_pd(), _mm256_castps_pd(low), 0);
+        both = _mm512_mask_insertf64x4(both, 0xFF, both, _mm256_castps_pd(high), 1);
+        return Pack16{_mm512_castpd_ps(both)};
+    }
+};
+} // namespace
+
+void intersect_triangles_avx512(const TriangleVertices *triangles, size_t count, const FloatVec3 *vertices,
+                                const float *center, const float *dir, float &min_t, int &obj_idx)
+{
+    intersect_triangles_wide<Pack16>(triangles, count, vertices, center, dir, min_t, obj_idx);
+}
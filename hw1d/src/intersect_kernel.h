@@ -0,0 +1,120 @@
+/**
+ * @file intersect_kernel.h
+ *
+ * @copyright 2022 Zecheng Qian, All rights reserved.
+ */
+#ifndef SRC_INTERSECT_KERNEL_H_
+#define SRC_INTERSECT_KERNEL_H_
+
+#include <cmath>
+#include <cstddef>
+#include "intersect.h"
+
+// the triangle test of intersect_triangles_baseline on P::WIDTH triangles at once
+// included by one source file per instruction set, each built with its own -m flags and defining its own P
+// those files must not call inline functions from shared headers, the linker could keep their
+// wider copy for the whole program, so this only reads plain fields and uses static functions
+
+// smallest float f with f > x, so that for a float a, a > x (compared in double) is a >= f
+static float float_above(double x)
+{
+    float f = float(x);
+    return double(f) > x ? f : nextafterf(f, INFINITY);
+}
+
+// smallest float f with f >= x, so that for a float a, a < x (compared in double) is a < f
+static float float_at_least(double x)
+{
+    float f = float(x);
+    return double(f) >= x ? f : nextafterf(f, INFINITY);
+}
+
+// every operation is done in the order of the scalar code, so each lane rounds the same way
+template <typename P>
+static void intersect_triangles_wide(const TriangleVertices *triangles, size_t count, const FloatVec3 *vertices,
+                                     const float *center, const float *dir, float &min_t, int &obj_idx)
+{
+    const int W = P::WIDTH;
+    // the scalar test compares against double constants
+    const P parallel_eps = P::splat(float_at_least(1e-6));
+    const P inside_low = P::splat(float_above(-1e-6));
+    const P t_low = P::splat(float_above(1e-3));
+    const P one = P::splat(1), half = P::splat(0.5f), three_halves = P::splat(1.5f);
+    const P cx = P::splat(center[0]), cy = P::splat(center[1]), cz = P::splat(center[2]);
+    const P dx = P::splat(dir[0]), dy = P::splat(dir[1]), dz = P::splat(dir[2]);
+    // the vertices of a batch in structure of arrays form, one row per coordinate
+    alignas(64) float batch[9][W];
+    alignas(64) float hit_t[W];
+    for (size_t k = 0; k < count; k += W)
+    {
+        int lanes = count - k < size_t(W) ? int(count - k) : W;
+        for (int l = 0; l < W; l++)
+        {
+            // the lanes past the end get a degenerate triangle, which never hits
+            const FloatVec3 *v[3] = {NULL, NULL, NULL};
+            if (l < lanes)
+            {
+                const TriangleVertices &t = triangles[k + l];
+                v[0] = &vertices[t.v0];
+                v[1] = &vertices[t.v1];
+                v[2] = &vertices[t.v2];
+            }
+            for (int i = 0; i < 3; i++)
+            {
+                batch[3 * i][l] = v[i] != NULL ? v[i]->first : 0;
+                batch[3 * i + 1][l] = v[i] != NULL ? v[i]->second : 0;
+                batch[3 * i + 2][l] = v[i] != NULL ? v[i]->third : 0;
+            }
+        }
+        P p0x = P::load(batch[0]), p0y = P::load(batch[1]), p0z = P::load(batch[2]);
+        P e1x = P::load(batch[3]) - p0x, e1y = P::load(batch[4]) - p0y, e1z = P::load(batch[5]) - p0z;
+        P e2x = P::load(batch[6]) - p0x, e2y = P::load(batch[7]) - p0y, e2z = P::load(batch[8]) - p0z;
+        // unit normal of the plane, the Newton step of normalize3_fast in simd.h
+        P nx = e1y * e2z - e1z * e2y;
+        P ny = e1z * e2x - e1x * e2z;
+        P nz = e1x * e2y - e1y * e2x;
+        P nn = (nx * nx + ny * ny) + nz * nz;
+        P r = P::rsqrt(nn);
+        r = r * (three_halves - half * nn * r * r);
+        nx = nx * r;
+        ny = ny * r;
+        nz = nz * r;
+        // parameters for the plane equation n.x + D = 0
+        P D = -((nx * p0x + ny * p0y) + nz * p0z);
+        P determinant = (nx * dx + ny * dy) + nz * dz;
+        P ray_t = -(((nx * cx + ny * cy) + nz * cz) + D) / determinant;
+        // barycentric coordinates of the intersection point
+        P epx = (cx + dx * ray_t) - p0x, epy = (cy + dy * ray_t) - p0y, epz = (cz + dz * ray_t) - p0z;
+        P d11 = (e1x * e1x + e1y * e1y) + e1z * e1z;
+        P d12 = (e1x * e2x + e1y * e2y) + e1z * e2z;
+        P d22 = (e2x * e2x + e2y * e2y) + e2z * e2z;
+        P dp1 = (epx * e1x + epy * e1y) + epz * e1z;
+        P dp2 = (epx * e2x + epy * e2y) + epz * e2z;
+        P det = d11 * d22 - d12 * d12;
+        P beta = (d22 * dp1 - d12 * dp2) / det;
+        P gamma = (d11 * dp2 - d12 * dp1) / det;
+        P alpha = one - beta - gamma;
+        // not parallel, inside the triangle, and nearer than the best hit so far
+        typename P::Mask hit = (P::abs(determinant) >= parallel_eps) & (ray_t >= t_low) & (ray_t < P::splat(min_t)) &
+                               (alpha >= inside_low) & (alpha < one) & (beta >= inside_low) & (beta < one) &
+                               (gamma >= inside_low) & (gamma < one);
+        unsigned bits = hit.bits() & ((1u << lanes) - 1);
+        if (bits == 0)
+        {
+            continue;
+        }
+        // take the hits in triangle order, so ties go to the same triangle as the scalar loop
+        ray_t.store(hit_t);
+        for (; bits != 0; bits &= bits - 1)
+        {
+            int l = __builtin_ctz(bits);
+            if (hit_t[l] < min_t)
+            {
+                min_t = hit_t[l];
+                obj_idx = int(k) + l;
+            }
+        }
+    }
+}
+
+#endif // SRC_INTERSECT_KERNEL_H_
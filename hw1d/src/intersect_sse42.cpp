@@ -0,0 +1,47 @@
+/**
+ * @file intersect_sse42.cpp
+ *
+ * @copyright 2022 Zecheng Qian, All rights reserved.
+ */
+#include <nmmintrin.h>
+#include "intersect_kernel.h"
+
+namespace
+{
+// four floats in an SSE register
+struct Pack4
+{
+    static const int WIDTH = 4;
+    __m128 v;
+
+    // lane mask from a comparison
+    struct Mask
+    {
+        __m128 m;
+        Mask operator&(const Mask &a) const { return Mask{_mm_and_ps(this->m, a.m)}; }
+        unsigned bits() const { return unsigned(_mm_movemask_ps(this->m)); }
+    };
+
+    static Pack4 splat(float c) { return Pack4{_mm_set1_ps(c)}; }
+    static Pack4 load(const float *p) { return Pack4{_mm_load_ps(p)}; }
+    void store(float *p) const { _mm_store_ps(p, this->v); }
+
+    Pack4 operator+(const Pack4 &a) const { return Pack4{_mm_add_ps(this->v, a.v)}; }
+    Pack4 operator-(const Pack4 &a) const { return Pack4{_mm_sub_ps(this->v, a.v)}; }
+    Pack4 operator*(const Pack4 &a) const { return Pack4{_mm_mul_ps(this->v, a.v)}; }
+    Pack4 operator/(const Pack4 &a) const { return Pack4{_mm_div_ps(this->v, a.v)}; }
+    Pack4 operator-() const { return Pack4{_mm_xor_ps(this->v, _mm_set1_ps(-0.0f))}; }
+    Mask operator<(const Pack4 &a) const { return Mask{_mm_cmplt_ps(this->v, a.v)}; }
+    Mask operator>=(const Pack4 &a) const { return Mask{_mm_cmpge_ps(this->v, a.v)}; }
+
+    static Pack4 abs(const Pack4 &a) { return Pack4{_mm_andnot_ps(_mm_set1_ps(-0.0f), a.v)}; }
+    // the hardware estimate, the same one Vec4f uses
+    static Pack4 rsqrt(const Pack4 &a) { return Pack4{_mm_rsqrt_ps(a.v)}; }
+};
+} // namespace
+
+void intersect_triangles_sse42(const TriangleVertices *triangles, size_t count, const FloatVec3 *vertices,
+                               const float *center, const float *dir, float &min_t, int &obj_idx)
+{
+    intersect_triangles_wide<Pack4>(triangles, count, vertices, center, dir, min_t, obj_idx);
+}
@@ -0,0 +1,53 @@
+/**
+ * @file mapped_file.cpp
+ *
+ * @copyright 2022 Zecheng Qian, All rights reserved.
+ */
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "mapped_file.h"
+
+MappedFile::MappedFile(const std::string &filename)
+{
+    this->open = false;
+    this->data = NULL;
+    this->size = 0;
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        return;
+    }
+    struct stat st;
+    if (fstat(fd, &st) == 0)
+    {
+        this->open = true;
+        this->size = st.st_size;
+        // mmap refuses empty mappings, an empty file is simply an empty range
+        if (this->size > 0)
+        {
+            void *block = mmap(NULL, this->size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (block == MAP_FAILED)
+            {
+                this->open = false;
+                this->size = 0;
+            }
+            else
+            {
+                this->data = static_cast<const char *>(block);
+                // the file is read front to back
+                madvise(block, this->size, MADV_SEQUENTIAL);
+            }
+        }
+    }
+    close(fd);
+}
+
+MappedFile::~MappedFile()
+{
+    if (this->data != NULL)
+    {
+        munmap(const_cast<char *>(this->data), this->size);
+    }
+}
@@ -0,0 +1,41 @@
+/**
+ * @file mapped_file.h
+ *
+ * @copyright 2022 Zecheng Qian, All rights reserved.
+ */
+#ifndef SRC_MAPPED_FILE_H_
+#define SRC_MAPPED_FILE_H_
+
+#include <cstddef>
+#include <string>
+
+// a read-only file mapped into memory, unmapped when destroyed
+class MappedFile
+{
+    public:
+        // constructor, map the whole file
+        explicit MappedFile(const std::string &filename);
+        // destructor
+        ~MappedFile();
+
+        // getter
+        bool isOpen() const { return this->open; }
+        const char *getData() const { return this->data; }
+        size_t getSize() const { return this->size; }
+        const char *begin() const { return this->data; }
+        const char *end() const { return this->data + this->size; }
+
+    private:
+        // not copyable, the mapping is owned
+        MappedFile(const MappedFile &);
+        MappedFile &operator=(const MappedFile &);
+
+        // whether the file was opened successfully
+        bool open;
+        // start of the mapping, NULL for an empty file
+        const char *data;
+        // size of the file in bytes
+        size_t size;
+};
+
+#endif // SRC_MAPPED_FILE_H_
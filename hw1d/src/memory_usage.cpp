@@ -0,0 +1,174 @@
+/**
+ * @file memory_usage.cpp
+ *
+ * @copyright 2022 Zecheng Qian, All rights reserved.
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <sys/resource.h>
+#include "memory_usage.h"
+#include "scene.h"
+
+namespace
+{
+// the bytes of every mipmap level of a texture or bump map, padding of partial tiles included
+template <typename T>
+size_t mipmap_bytes(const T &image, size_t &levels)
+{
+    size_t bytes = 0;
+    for (int level = 0; level < image.getLevels(); level++)
+    {
+        bytes += image.getLevel(level).capacity() * sizeof(*image.getLevel(level).data());
+        levels += !image.getLevel(level).empty();
+    }
+    return bytes;
+}
+
+// a field of /proc/self/status in bytes, 0 when it cannot be read
+size_t proc_status_bytes(const char *field)
+{
+    FILE *file = fopen("/proc/self/status", "r");
+    if (file == NULL)
+    {
+        return 0;
+    }
+    char line[256];
+    size_t kb = 0;
+    size_t length = strlen(field);
+    while (fgets(line, sizeof(line), file) != NULL)
+    {
+        if (strncmp(line, field, length) == 0 && line[length] == ':')
+        {
+            kb = strtoull(line + length + 1, NULL, 10);
+            break;
+        }
+    }
+    fclose(file);
+    return kb * 1024;
+}
+
+double kilobytes(size_t bytes)
+{
+    return bytes / 1024.0;
+}
+} // namespace
+
+bool memory_enabled()
+{
+    const char *env = getenv("RAYTRACER_MEMORY");
+    return env != NULL && env[0] != '\0' && std::string(env) != "0";
+}
+
+void add_scene_memory(std::vector<MemoryItem> &items, const Scene &scene)
+{
+    add_memory(items, "scene", "material_list", scene.getMaterialList());
+    add_memory(items, "scene", "sphere_list", scene.getSphereList());
+    add_memory(items, "scene", "cylinder_list", scene.getCylinderList());
+    add_memory(items, "scene", "vertex_list", scene.getVertexList());
+    add_memory(items, "scene", "vertex_normal_list", scene.getVertexNormalList());
+    add_memory(items, "scene", "texture_coordinate_list", scene.getTextureCoordinateList());
+    add_memory(items, "scene", "triangle_vertex_list", scene.getTriangleVertexList());
+    add_memory(items, "scene", "triangle_list", scene.getTriangleList());
+    add_memory(items, "scene", "light_list", scene.getLightList());
+    add_memory(items, "scene", "attlight_list", scene.getAttLightList());
+
+    // the lists hold the lookup tables and procedural parameters, the images are separate
+    add_memory(items, "textures", "texture_list", scene.getTextureList());
+    add_memory(items, "textures", "bump_list", scene.getBumpList());
+    MemoryItem texture_images = {"textures", "texture images", 0, 0};
+    for (size_t k = 0; k < scene.getTextureList().size(); k++)
+    {
+        texture_images.bytes += mipmap_bytes(scene.getTextureList()[k], texture_images.count);
+    }
+    items.push_back(texture_images);
+    MemoryItem bump_images = {"textures", "bump map images", 0, 0};
+    for (size_t k = 0; k < scene.getBumpList().size(); k++)
+    {
+        bump_images.bytes += mipmap_bytes(scene.getBumpList()[k], bump_images.count);
+    }
+    items.push_back(bump_images);
+
+    // there is no bounding volume hierarchy yet, the line keeps the report stable when one is added
+    MemoryItem acceleration = {"acceleration", "none", 0, 0};
+    items.push_back(acceleration);
+}
+
+size_t peak_rss()
+{
+    size_t bytes = proc_status_bytes("VmHWM");
+    if (bytes == 0)
+    {
+        // bytes on macOS, kilobytes elsewhere
+        struct rusage usage;
+        if (getrusage(RUSAGE_SELF, &usage) == 0)
+        {
+            bytes = size_t(usage.ru_maxrss);
+#ifndef __APPLE__
+            bytes *= 1024;
+#endif
+        }
+    }
+    return bytes;
+}
+
+size_t current_rss()
+{
+    return proc_status_bytes("VmRSS");
+}
+
+void report_memory(const std::vector<MemoryItem> &items)
+{
+    if (!memory_enabled())
+    {
+        return;
+    }
+    std::map<std::string, size_t> totals;
+    size_t total = 0;
+    fprintf(stderr, "%-14s %-24s %12s %12s\n", "memory", "", "count", "KB");
+    for (size_t k = 0; k < items.size(); k++)
+    {
+        const MemoryItem &item = items[k];
+        fprintf(stderr, "%-14s %-24s %12zu %12.1f\n", item.group.c_str(), item.name.c_str(), item.count, kilobytes(item.bytes));
+        totals[item.group] += item.bytes;
+        total += item.bytes;
+    }
+    std::map<std::string, size_t>::const_iterator group;
+    for (group = totals.begin(); group != totals.end(); ++group)
+    {
+        fprintf(stderr, "total %-33s %12.1f\n", group->first.c_str(), kilobytes(group->second));
+    }
+    size_t peak = peak_rss();
+    size_t rss = current_rss();
+    fprintf(stderr, "accounted %.1f KB, resident %.1f KB, peak resident %.1f KB\n",
+            kilobytes(total), kilobytes(rss), kilobytes(peak));
+
+    // RAYTRACER_MEMORY=1 only prints, a file name also writes the numbers as json
+    std::string path = getenv("RAYTRACER_MEMORY");
+    if (path == "1")
+    {
+        return;
+    }
+    FILE *file = fopen(path.c_str(), "w");
+    if (file == NULL)
+    {
+        fprintf(stderr, "Could not open output stream with file %s\n", path.c_str());
+        return;
+    }
+    // the names are identifiers chosen here, they need no escaping
+    fprintf(file, "{\n  \"items\": [");
+    for (size_t k = 0; k < items.size(); k++)
+    {
+        fprintf(file, "%s\n    {\"group\": \"%s\", \"name\": \"%s\", \"count\": %zu, \"bytes\": %zu}",
+                k == 0 ? "" : ",", items[k].group.c_str(), items[k].name.c_str(), items[k].count, items[k].bytes);
+    }
+    fprintf(file, "\n  ],\n  \"groups\": {");
+    for (group = totals.begin(); group != totals.end(); ++group)
+    {
+        fprintf(file, "%s\"%s\": %zu", group == totals.begin() ? "" : ", ", group->first.c_str(), group->second);
+    }
+    fprintf(file, "},\n  \"accounted_bytes\": %zu,\n  \"rss_bytes\": %zu,\n  \"peak_rss_bytes\": %zu\n}\n",
+            total, rss, peak);
+    fclose(file);
+}
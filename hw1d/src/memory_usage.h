@@ -0,0 +1,59 @@
+/**
+ * @file memory_usage.h
+ *
+ * @copyright 2022 Zecheng Qian, All rights reserved.
+ */
+#ifndef SRC_MEMORY_USAGE_H_
+#define SRC_MEMORY_USAGE_H_
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "image.h"
+
+class Scene;
+
+// a breakdown of the memory held by the scene and the framebuffers, printed to stderr at exit
+// with RAYTRACER_MEMORY=1, or RAYTRACER_MEMORY=file.json to also write it as json
+// the sizes are what the containers have allocated, their capacity rather than their size
+
+// one line of the breakdown
+typedef struct MemoryItemType
+{
+    std::string group; // scene, textures, acceleration or framebuffers
+    std::string name;
+    size_t count;      // elements, or images for textures and bump maps
+    size_t bytes;
+} MemoryItem;
+
+// whether RAYTRACER_MEMORY is set
+bool memory_enabled();
+
+// the bytes allocated by a list
+template <typename T>
+void add_memory(std::vector<MemoryItem> &items, const std::string &group, const std::string &name, const std::vector<T> &list)
+{
+    MemoryItem item = {group, name, list.size(), list.capacity() * sizeof(T)};
+    items.push_back(item);
+}
+
+// the bytes of the pixels of an image
+template <typename T>
+void add_memory(std::vector<MemoryItem> &items, const std::string &group, const std::string &name, const Image<T> &image)
+{
+    MemoryItem item = {group, name, image.size(), image.size() * sizeof(T)};
+    items.push_back(item);
+}
+
+// every list of the scene, the texture and bump map images with their mipmaps,
+// and the acceleration structure, which is empty, every ray tests every object
+void add_scene_memory(std::vector<MemoryItem> &items, const Scene &scene);
+
+// the peak and current resident set size of the process in bytes, 0 when unknown
+size_t peak_rss();
+size_t current_rss();
+
+// print the breakdown and the peak resident set size, and write the json file if asked for
+void report_memory(const std::vector<MemoryItem> &items);
+
+#endif // SRC_MEMORY_USAGE_H_
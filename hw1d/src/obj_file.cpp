@@ -0,0 +1,253 @@
+/**
+ * @file obj_file.cpp
+ *
+ * @copyright 2022 Zecheng Qian, All rights reserved.
+ */
+#include <cstdio>
+#include <map>
+#include "obj_file.h"
+#include "mapped_file.h"
+#include "tokenizer.h"
+
+// directory part of a path, including the trailing slash, empty for a bare filename
+static std::string directory_of(const std::string &filename)
+{
+    size_t slash = filename.find_last_of('/');
+    return slash == std::string::npos ? "" : filename.substr(0, slash + 1);
+}
+
+// read up to n floats, the missing ones keep their value
+static void read_floats(Tokenizer &tok, float *float_var, int n)
+{
+    for (int k = 0; k < n && tok.readFloat(float_var[k]); k++)
+    {
+    }
+}
+
+// read the rest of the line as a path, options such as "-bm 0.5" before it are skipped
+static std::string read_map(Tokenizer &tok)
+{
+    std::string path, token;
+    while (tok.readString(token))
+    {
+        path = token;
+    }
+    return path;
+}
+
+// convert an OBJ index to a 0-based one, negative indices count back from the last element
+// return -1 if the index is out of range
+static int resolve_index(int idx, size_t count)
+{
+    long k = idx > 0 ? long(idx) - 1 : long(count) + idx;
+    return (idx == 0 || k < 0 || k >= long(count)) ? -1 : int(k);
+}
+
+void ObjFile::loadMtl(const std::string &filename)
+{
+    MappedFile file(filename);
+    if (!file.isOpen())
+    {
+        fprintf(stderr, "Could not open material library %s\n", filename.c_str());
+        return;
+    }
+    // texture paths are relative to the library
+    std::string dir = directory_of(filename);
+    ObjMaterial *material = NULL;
+    Tokenizer scanner(file.begin(), file.end());
+    while (!scanner.done())
+    {
+        const char *line_begin, *line_end;
+        scanner.nextLine(line_begin, line_end);
+        Tokenizer iss(line_begin, line_end);
+        const char *keyword;
+        size_t len;
+        float float_var[3] = {0, 0, 0};
+        if (!iss.readWord(keyword, len))
+        {
+            continue;
+        }
+        if (word_equal(keyword, len, "newmtl"))
+        {
+            ObjMaterial defaults;
+            iss.readString(defaults.name);
+            defaults.Kd = Color(0.8, 0.8, 0.8);
+            defaults.Ks = Color(0, 0, 0);
+            defaults.Ns = 1;
+            defaults.d = 1;
+            defaults.Ni = 1;
+            this->material_list.push_back(defaults);
+            material = &this->material_list.back();
+        }
+        else if (material == NULL)
+        {
+            // properties before the first newmtl belong to no material
+            continue;
+        }
+        else if (word_equal(keyword, len, "Kd"))
+        {
+            read_floats(iss, float_var, 3);
+            material->Kd = Color(float_var[0], float_var[1], float_var[2]);
+        }
+        else if (word_equal(keyword, len, "Ks"))
+        {
+            read_floats(iss, float_var, 3);
+            material->Ks = Color(float_var[0], float_var[1], float_var[2]);
+        }
+        else if (word_equal(keyword, len, "Ns"))
+        {
+            read_floats(iss, float_var, 1);
+            material->Ns = float_var[0];
+        }
+        else if (word_equal(keyword, len, "d"))
+        {
+            read_floats(iss, float_var, 1);
+            material->d = float_var[0];
+        }
+        else if (word_equal(keyword, len, "Tr"))
+        {
+            // transparency, the complement of d
+            read_floats(iss, float_var, 1);
+            material->d = 1 - float_var[0];
+        }
+        else if (word_equal(keyword, len, "Ni"))
+        {
+            read_floats(iss, float_var, 1);
+            material->Ni = float_var[0];
+        }
+        else if (word_equal(keyword, len, "map_Kd"))
+        {
+            std::string path = read_map(iss);
+            material->map_Kd = path.empty() ? path : dir + path;
+        }
+        else if (word_equal(keyword, len, "map_bump") || word_equal(keyword, len, "bump"))
+        {
+            std::string path = read_map(iss);
+            material->map_bump = path.empty() ? path : dir + path;
+        }
+    }
+}
+
+bool ObjFile::load(const std::string &filename)
+{
+    MappedFile file(filename);
+    if (!file.isOpen())
+    {
+        fprintf(stderr, "Could not open mesh file %s\n", filename.c_str());
+        return false;
+    }
+    // material libraries are relative to the mesh
+    std::string dir = directory_of(filename);
+    std::map<std::string, int> material_idx;
+    int current_material = -1;
+    // vertex references of the current polygon
+    std::vector<int> v, vt, vn;
+    Tokenizer scanner(file.begin(), file.end());
+    while (!scanner.done())
+    {
+        const char *line_begin, *line_end;
+        scanner.nextLine(line_begin, line_end);
+        Tokenizer iss(line_begin, line_end);
+        const char *keyword;
+        size_t len;
+        float float_var[3] = {0, 0, 0};
+        if (!iss.readWord(keyword, len))
+        {
+            continue;
+        }
+        if (word_equal(keyword, len, "v"))
+        {
+            read_floats(iss, float_var, 3);
+            this->vertex_list.push_back(FloatVec3(float_var[0], float_var[1], float_var[2]));
+        }
+        else if (word_equal(keyword, len, "vn"))
+        {
+            read_floats(iss, float_var, 3);
+            this->vertex_normal_list.push_back(FloatVec3(float_var[0], float_var[1], float_var[2]).normal());
+        }
+        else if (word_equal(keyword, len, "vt"))
+        {
+            read_floats(iss, float_var, 2);
+            this->texture_coordinate_list.push_back(FloatVec2(float_var[0], float_var[1]));
+        }
+        else if (word_equal(keyword, len, "f"))
+        {
+            // read every vertex of the polygon in the format v, v/vt, v//vn or v/vt/vn
+            v.clear();
+            vt.clear();
+            vn.clear();
+            bool has_vt = true, has_vn = true, valid = true;
+            int idx[3];
+            while (iss.readInt(idx[0]))
+            {
+                idx[1] = idx[2] = 0;
+                if (iss.accept('/'))
+                {
+                    if (!iss.accept('/'))
+                    {
+                        iss.readInt(idx[1]);
+                        if (iss.accept('/'))
+                        {
+                            iss.readInt(idx[2]);
+                        }
+                    }
+                    else
+                    {
+                        iss.readInt(idx[2]);
+                    }
+                }
+                v.push_back(resolve_index(idx[0], this->vertex_list.size()));
+                vt.push_back(resolve_index(idx[1], this->texture_coordinate_list.size()));
+                vn.push_back(resolve_index(idx[2], this->vertex_normal_list.size()));
+                valid = valid && v.back() != -1;
+                has_vt = has_vt && vt.back() != -1;
+                has_vn = has_vn && vn.back() != -1;
+            }
+            if (!valid || v.size() < 3)
+            {
+                continue;
+            }
+            // triangulate the polygon as a fan around its first vertex
+            for (size_t k = 1; k + 1 < v.size(); k++)
+            {
+                size_t corner[3] = {0, k, k + 1};
+                ObjTriangle triangle;
+                for (int c = 0; c < 3; c++)
+                {
+                    triangle.v[c] = v[corner[c]];
+                    triangle.vt[c] = has_vt ? vt[corner[c]] : -1;
+                    triangle.vn[c] = has_vn ? vn[corner[c]] : -1;
+                }
+                triangle.material = current_material;
+                this->triangle_list.push_back(triangle);
+            }
+        }
+        else if (word_equal(keyword, len, "usemtl"))
+        {
+            std::string name;
+            iss.readString(name);
+            std::map<std::string, int>::const_iterator it = material_idx.find(name);
+            current_material = it == material_idx.end() ? -1 : it->second;
+            if (it == material_idx.end())
+            {
+                fprintf(stderr, "Unknown material %s in %s\n", name.c_str(), filename.c_str());
+            }
+        }
+        else if (word_equal(keyword, len, "mtllib"))
+        {
+            // a line may list several libraries
+            std::string library;
+            while (iss.readString(library))
+            {
+                size_t first = this->material_list.size();
+                this->library_list.push_back(dir + library);
+                this->loadMtl(dir + library);
+                for (size_t k = first; k < this->material_list.size(); k++)
+                {
+                    material_idx[this->material_list[k].name] = k;
+                }
+            }
+        }
+    }
+    return true;
+}
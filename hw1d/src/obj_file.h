@@ -0,0 +1,62 @@
+/**
+ * @file obj_file.h
+ *
+ * @copyright 2022 Zecheng Qian, All rights reserved.
+ */
+#ifndef SRC_OBJ_FILE_H_
+#define SRC_OBJ_FILE_H_
+
+#include <string>
+#include <vector>
+#include "types.h"
+#include "color.h"
+
+// a material of a MTL library, only the fields the ray tracer can use are kept
+typedef struct ObjMaterialType
+{
+    std::string name;
+    // diffuse and specular colors
+    Color Kd, Ks;
+    // specular exponent, opacity and index of refraction
+    float Ns, d, Ni;
+    // texture image and normal map, relative to the working directory, empty if none
+    std::string map_Kd, map_bump;
+} ObjMaterial;
+
+// a triangle of a mesh, indices start from 0 and a missing index is -1
+typedef struct ObjTriangleType
+{
+    int v[3], vt[3], vn[3];
+    // index into the material list, -1 before the first usemtl
+    int material;
+} ObjTriangle;
+
+// a polygon mesh read from a Wavefront OBJ file and the MTL libraries it references
+class ObjFile
+{
+    public:
+        // read the mesh, return false if the file could not be opened
+        bool load(const std::string &filename);
+
+        // getter
+        const std::vector<FloatVec3> &getVertexList() const { return this->vertex_list; }
+        const std::vector<FloatVec3> &getVertexNormalList() const { return this->vertex_normal_list; }
+        const std::vector<FloatVec2> &getTextureCoordinateList() const { return this->texture_coordinate_list; }
+        const std::vector<ObjTriangle> &getTriangleList() const { return this->triangle_list; }
+        const std::vector<ObjMaterial> &getMaterialList() const { return this->material_list; }
+        // the MTL libraries named by the mesh, whether or not they could be opened
+        const std::vector<std::string> &getLibraryList() const { return this->library_list; }
+
+    private:
+        // read the materials of a MTL library
+        void loadMtl(const std::string &filename);
+
+        std::vector<FloatVec3> vertex_list;
+        std::vector<FloatVec3> vertex_normal_list;
+        std::vector<FloatVec2> texture_coordinate_list;
+        std::vector<ObjTriangle> triangle_list;
+        std::vector<ObjMaterial> material_list;
+        std::vector<std::string> library_list;
+};
+
+#endif // SRC_OBJ_FILE_H_
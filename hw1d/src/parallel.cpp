@@ -0,0 +1,46 @@
+/**
+ * @file parallel.cpp
+ *
+ * @copyright 2022 Zecheng Qian, All rights reserved.
+ */
+#include <cstdlib>
+#include <algorithm>
+#include <thread>
+#include <vector>
+#include "parallel.h"
+
+int num_threads()
+{
+    const char *env = getenv("RAYTRACER_THREADS");
+    if (env != NULL && atoi(env) > 0)
+    {
+        return atoi(env);
+    }
+    return std::max(1, int(std::thread::hardware_concurrency()));
+}
+
+void parallel_for(size_t n, size_t min_chunk, const std::function<void(size_t, size_t)> &body)
+{
+    if (n == 0)
+    {
+        return;
+    }
+    size_t chunks = std::min(size_t(num_threads()), std::max(size_t(1), n / std::max(size_t(1), min_chunk)));
+    if (chunks <= 1)
+    {
+        body(0, n);
+        return;
+    }
+    std::vector<std::thread> workers;
+    size_t step = (n + chunks - 1) / chunks;
+    // the calling thread takes the first chunk
+    for (size_t begin = step; begin < n; begin += step)
+    {
+        workers.push_back(std::thread(body, begin, std::min(n, begin + step)));
+    }
+    body(0, std::min(n, step));
+    for (size_t k = 0; k < workers.size(); k++)
+    {
+        workers[k].join();
+    }
+}
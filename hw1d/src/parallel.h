@@ -0,0 +1,31 @@
+/**
+ * @file parallel.h
+ *
+ * @copyright 2022 Zecheng Qian, All rights reserved.
+ */
+#ifndef SRC_PARALLEL_H_
+#define SRC_PARALLEL_H_
+
+#include <cstddef>
+#include <functional>
+#include <future>
+#include <type_traits>
+
+// number of worker threads to use, the number of hardware threads by default
+// can be overridden with the RAYTRACER_THREADS environment variable
+int num_threads();
+
+// split the range [0, n) into contiguous chunks of at least min_chunk items,
+// and call body(begin, end) on each chunk from a pool of threads
+// runs on the calling thread when there is only one chunk
+void parallel_for(size_t n, size_t min_chunk, const std::function<void(size_t, size_t)> &body);
+
+// start a task in the background and return a future for its result
+// with only one thread the task is deferred and runs on the thread that calls get()
+template <typename F>
+std::future<typename std::result_of<F()>::type> run_async(F task)
+{
+    return std::async(num_threads() > 1 ? std::launch::async : std::launch::deferred, task);
+}
+
+#endif // SRC_PARALLEL_H_
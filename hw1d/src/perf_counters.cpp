@@ -0,0 +1,380 @@
+/**
+ * @file perf_counters.cpp
+ *
+ * @copyright 2022 Zecheng Qian, All rights reserved.
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <string>
+#include <algorithm>
+#include <mutex>
+#include "perf_counters.h"
+
+#ifdef __linux__
+#include <unistd.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+// deepest nesting of scopes on one thread
+#define PERF_MAX_DEPTH 16
+
+namespace
+{
+typedef struct PerfEventType
+{
+    const char *name;
+    uint32_t type;
+    uint64_t config;
+} PerfEvent;
+
+#ifdef __linux__
+// the group leader comes first, instructions follow cycles so the ipc can be derived
+const PerfEvent hardware_events[] = {
+    {"cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {"instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {"cache refs", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_REFERENCES},
+    {"cache misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    {"branches", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_INSTRUCTIONS},
+    {"branch misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+};
+const PerfEvent software_events[] = {
+    {"task clock ns", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK},
+    {"page faults", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_PAGE_FAULTS},
+    {"context switches", PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES},
+};
+#endif
+
+// the events every thread opens, picked by the first thread
+const PerfEvent *events = NULL;
+int num_events = 0;
+// whether events are the hardware ones, which get the ipc and miss rate columns
+bool hardware_events_chosen = false;
+std::once_flag events_chosen;
+
+std::mutex perf_mutex;
+// counts of the threads that have exited
+PerfCounts retired_counts[PERF_PHASES];
+bool multiplexed = false;
+
+void add_counts(PerfCounts &total, const PerfCounts &counts)
+{
+    for (int e = 0; e < PERF_MAX_EVENTS; e++)
+    {
+        total.value[e] += counts.value[e];
+    }
+}
+
+#ifdef __linux__
+int open_event(const PerfEvent &event, int group)
+{
+    perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = event.type;
+    attr.config = event.config;
+    // only this process in user mode, which is what an unprivileged user may count
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return int(syscall(SYS_perf_event_open, &attr, 0, -1, group, 0));
+}
+#endif
+
+// the counters of one thread, opened on its first scope
+struct PerfThread
+{
+    int fds[PERF_MAX_EVENTS];
+    bool open;
+    // the last reading, and the phases of the scopes that are open
+    PerfCounts last;
+    int stack[PERF_MAX_DEPTH];
+    int depth;
+    PerfCounts counts[PERF_PHASES];
+
+    PerfThread()
+        : open(false), depth(0)
+    {
+        std::fill(this->fds, this->fds + PERF_MAX_EVENTS, -1);
+        memset(&this->last, 0, sizeof(this->last));
+        memset(this->counts, 0, sizeof(this->counts));
+    }
+
+    ~PerfThread()
+    {
+        std::lock_guard<std::mutex> lock(perf_mutex);
+        for (int p = 0; p < PERF_PHASES; p++)
+        {
+            add_counts(retired_counts[p], this->counts[p]);
+        }
+        this->close();
+    }
+
+    bool start()
+    {
+#ifdef __linux__
+        for (int e = 0; e < num_events; e++)
+        {
+            this->fds[e] = open_event(events[e], e == 0 ? -1 : this->fds[0]);
+            if (this->fds[e] < 0)
+            {
+                this->close();
+                return false;
+            }
+        }
+        this->open = num_events > 0;
+        return this->open && this->read(this->last);
+#else
+        return false;
+#endif
+    }
+
+    void close()
+    {
+#ifdef __linux__
+        for (int e = 0; e < PERF_MAX_EVENTS; e++)
+        {
+            if (this->fds[e] >= 0)
+            {
+                ::close(this->fds[e]);
+                this->fds[e] = -1;
+            }
+        }
+#endif
+        this->open = false;
+    }
+
+    // read the whole group at once
+    bool read(PerfCounts &counts)
+    {
+#ifdef __linux__
+        uint64_t data[3 + PERF_MAX_EVENTS];
+        ssize_t size = ::read(this->fds[0], data, sizeof(data));
+        if (size < ssize_t((3 + num_events) * sizeof(uint64_t)))
+        {
+            return false;
+        }
+        // nr, time enabled, time running, then the values in the order the events were opened
+        if (data[2] < data[1])
+        {
+            multiplexed = true;
+        }
+        memset(&counts, 0, sizeof(counts));
+        for (int e = 0; e < num_events; e++)
+        {
+            counts.value[e] = data[3 + e];
+        }
+        return true;
+#else
+        (void)counts;
+        return false;
+#endif
+    }
+
+    // read the counters and give what was counted since the last reading to the innermost scope
+    void attribute(PerfCounts &now)
+    {
+        this->read(now);
+        if (this->depth > 0 && this->depth <= PERF_MAX_DEPTH)
+        {
+            PerfCounts &counts = this->counts[this->stack[this->depth - 1]];
+            for (int e = 0; e < num_events; e++)
+            {
+                counts.value[e] += now.value[e] - this->last.value[e];
+            }
+        }
+        this->last = now;
+    }
+};
+
+std::mutex threads_mutex;
+std::vector<PerfThread *> live_threads;
+
+// registers the thread while it runs
+struct PerfThreadSlot
+{
+    PerfThread thread;
+
+    PerfThreadSlot()
+    {
+        std::lock_guard<std::mutex> lock(threads_mutex);
+        live_threads.push_back(&this->thread);
+    }
+
+    ~PerfThreadSlot()
+    {
+        std::lock_guard<std::mutex> lock(threads_mutex);
+        live_threads.erase(std::find(live_threads.begin(), live_threads.end(), &this->thread));
+    }
+};
+
+thread_local PerfThreadSlot slot;
+
+// pick the events, hardware ones if the kernel lets this process count them
+void choose_events()
+{
+    const char *env = getenv("RAYTRACER_PERF");
+    if (env == NULL || std::string(env) == "0" || env[0] == '\0')
+    {
+        return;
+    }
+#ifdef __linux__
+    PerfThread probe;
+    events = hardware_events;
+    num_events = sizeof(hardware_events) / sizeof(hardware_events[0]);
+    if (probe.start())
+    {
+        probe.close();
+        hardware_events_chosen = true;
+        return;
+    }
+    int hardware_errno = errno;
+    events = software_events;
+    num_events = sizeof(software_events) / sizeof(software_events[0]);
+    if (probe.start())
+    {
+        probe.close();
+        fprintf(stderr, "Hardware performance counters are not available (%s), counting software events\n",
+                strerror(hardware_errno));
+        return;
+    }
+    fprintf(stderr, "Performance counters are not available (%s), check /proc/sys/kernel/perf_event_paranoid\n",
+            strerror(errno));
+#else
+    fprintf(stderr, "Performance counters are only supported on Linux\n");
+#endif
+    events = NULL;
+    num_events = 0;
+}
+
+// the counters of the calling thread, NULL when counting is off or could not start
+PerfThread *thread_counters()
+{
+    std::call_once(events_chosen, choose_events);
+    if (num_events == 0)
+    {
+        return NULL;
+    }
+    PerfThread &thread = slot.thread;
+    if (!thread.open && !thread.start())
+    {
+        return NULL;
+    }
+    return &thread;
+}
+} // namespace
+
+bool perf_enabled()
+{
+    std::call_once(events_chosen, choose_events);
+    return num_events > 0;
+}
+
+PerfScope::PerfScope(PerfPhase phase, PerfCounts *inclusive)
+    : active(false), inclusive(inclusive)
+{
+    PerfThread *thread = thread_counters();
+    if (thread == NULL || thread->depth >= PERF_MAX_DEPTH)
+    {
+        return;
+    }
+    thread->attribute(this->start);
+    thread->stack[thread->depth++] = phase;
+    this->active = true;
+}
+
+PerfScope::~PerfScope()
+{
+    if (!this->active)
+    {
+        return;
+    }
+    PerfThread &thread = slot.thread;
+    PerfCounts now;
+    thread.attribute(now);
+    thread.depth--;
+    if (this->inclusive != NULL)
+    {
+        for (int e = 0; e < PERF_MAX_EVENTS; e++)
+        {
+            this->inclusive->value[e] = now.value[e] - this->start.value[e];
+        }
+    }
+}
+
+// ratio that reads well in a table
+static double ratio(uint64_t a, uint64_t b)
+{
+    return b > 0 ? double(a) / b : 0.0;
+}
+
+void print_perf(const std::vector<PerfCounts> &rows)
+{
+    static const char *phases[PERF_PHASES] = {"parse", "render", "output", "traversal", "shading", "texture"};
+    if (!perf_enabled())
+    {
+        return;
+    }
+    PerfCounts totals[PERF_PHASES];
+    {
+        std::lock_guard<std::mutex> lock(perf_mutex);
+        std::copy(retired_counts, retired_counts + PERF_PHASES, totals);
+        std::lock_guard<std::mutex> threads_lock(threads_mutex);
+        for (size_t t = 0; t < live_threads.size(); t++)
+        {
+            for (int p = 0; p < PERF_PHASES; p++)
+            {
+                add_counts(totals[p], live_threads[t]->counts[p]);
+            }
+        }
+    }
+    bool hardware = hardware_events_chosen;
+    fprintf(stderr, "%-10s", "counters");
+    for (int e = 0; e < num_events; e++)
+    {
+        fprintf(stderr, " %16s", events[e].name);
+    }
+    fprintf(stderr, hardware ? " %6s %12s %12s\n" : "\n", "ipc", "cache miss %", "branch miss %");
+    for (int p = 0; p < PERF_PHASES; p++)
+    {
+        if (totals[p].value[0] == 0)
+        {
+            continue;
+        }
+        fprintf(stderr, "%-10s", phases[p]);
+        for (int e = 0; e < num_events; e++)
+        {
+            fprintf(stderr, " %16llu", (unsigned long long)totals[p].value[e]);
+        }
+        if (hardware)
+        {
+            const uint64_t *v = totals[p].value;
+            fprintf(stderr, " %6.2f %12.2f %12.2f", ratio(v[1], v[0]), 100 * ratio(v[3], v[2]), 100 * ratio(v[5], v[4]));
+        }
+        fprintf(stderr, "\n");
+    }
+    // the spread over the rows shows where the expensive parts of the image are
+    if (!rows.empty())
+    {
+        std::vector<double> per_row(rows.size());
+        for (size_t r = 0; r < rows.size(); r++)
+        {
+            per_row[r] = hardware ? ratio(rows[r].value[1], rows[r].value[0]) : double(rows[r].value[0]);
+        }
+        std::vector<double> sorted = per_row;
+        std::sort(sorted.begin(), sorted.end());
+        size_t slowest = std::max_element(per_row.begin(), per_row.end()) - per_row.begin();
+        if (hardware)
+        {
+            slowest = std::min_element(per_row.begin(), per_row.end()) - per_row.begin();
+        }
+        fprintf(stderr, "rows %s: min %.3g, median %.3g, max %.3g, worst row %zu\n",
+                hardware ? "ipc" : events[0].name, sorted.front(), sorted[sorted.size() / 2], sorted.back(), slowest);
+    }
+    if (multiplexed)
+    {
+        fprintf(stderr, "The counter group was not always scheduled, the counts are a lower bound\n");
+    }
+}
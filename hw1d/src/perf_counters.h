@@ -0,0 +1,70 @@
+/**
+ * @file perf_counters.h
+ *
+ * @copyright 2022 Zecheng Qian, All rights reserved.
+ */
+#ifndef SRC_PERF_COUNTERS_H_
+#define SRC_PERF_COUNTERS_H_
+
+#include <cstdint>
+#include <vector>
+
+// hardware performance counters read with the Linux perf_event_open, enabled with RAYTRACER_PERF=1
+// cycles, instructions, cache references and misses, branches and branch misses are counted
+// as one group on each thread, falling back to software counters when the kernel does not
+// allow hardware ones, and to nothing at all off Linux or when perf events are not permitted
+
+// the phases the counts are attributed to
+enum PerfPhase
+{
+    PERF_PARSE,
+    PERF_RENDER,
+    PERF_OUTPUT,
+    PERF_TRAVERSAL,
+    PERF_SHADING,
+    PERF_TEXTURE,
+    PERF_PHASES
+};
+
+// most events in a group
+#define PERF_MAX_EVENTS 6
+
+// counts of the events of a group
+typedef struct PerfCountsType
+{
+    uint64_t value[PERF_MAX_EVENTS];
+} PerfCounts;
+
+// whether RAYTRACER_PERF is set and a counter group could be opened
+bool perf_enabled();
+
+// the counts between construction and destruction go to the phase, excluding nested scopes,
+// which count for their own phase, so shadow rays cast while shading are traversal
+// every scope costs two reads of the counters, a system call each
+class PerfScope
+{
+    public:
+        // inclusive, if given, receives everything counted inside the scope, nested scopes included
+        explicit PerfScope(PerfPhase phase, PerfCounts *inclusive = NULL);
+        ~PerfScope();
+
+    private:
+        bool active;
+        PerfCounts *inclusive;
+        PerfCounts start;
+};
+
+// print the counts of every phase to stderr, and their spread over the rows when given
+void print_perf(const std::vector<PerfCounts> &rows);
+
+// scopes around traversal, shading and texture sampling run millions of times per image,
+// they are only compiled in builds with the statistics, see stats.h
+#ifdef RAYTRACER_STATS
+#define PERF_SCOPE_NAME(line) perf_scope_##line
+#define PERF_SCOPE_AT(phase, line) PerfScope PERF_SCOPE_NAME(line)(phase)
+#define PERF_SCOPE(phase) PERF_SCOPE_AT(phase, __LINE__)
+#else
+#define PERF_SCOPE(phase) ((void)0)
+#endif
+
+#endif // SRC_PERF_COUNTERS_H_
@@ -0,0 +1,162 @@
+/**
+ * @file procedural.cpp
+ *
+ * @copyright 2022 Zecheng Qian, All rights reserved.
+ */
+#include <algorithm>
+#include <cstdint>
+#include "procedural.h"
+
+// integral of the square wave that is 1 on odd cells [2k+1, 2k+2) and 0 elsewhere
+static float square_wave_integral(float x)
+{
+    float h = x / 2;
+    return std::floor(h) + std::max(2 * (h - std::floor(h)) - 1, float(0));
+}
+
+// fraction of a box of width w centered at x that covers odd cells
+static float square_wave(float x, float w)
+{
+    if (w < 1e-4)
+    {
+        return std::fmod(std::floor(x), float(2)) != 0 ? 1 : 0;
+    }
+    return (square_wave_integral(x + w / 2) - square_wave_integral(x - w / 2)) / w;
+}
+
+// hash a lattice point into one of 8 gradient directions
+static int lattice_hash(int x, int y)
+{
+    uint32_t h = uint32_t(x) * 374761393u + uint32_t(y) * 668265263u;
+    h = (h ^ (h >> 13)) * 1274126177u;
+    return (h ^ (h >> 16)) & 7;
+}
+
+// dot product between the gradient of a lattice point and the offset (x, y)
+static float gradient(int h, float x, float y)
+{
+    static const float gx[8] = {1, -1, 0, 0, 0.70710678f, -0.70710678f, 0.70710678f, -0.70710678f};
+    static const float gy[8] = {0, 0, 1, -1, 0.70710678f, 0.70710678f, -0.70710678f, -0.70710678f};
+    return gx[h] * x + gy[h] * y;
+}
+
+// wrap a lattice coordinate into [0, period)
+static int wrap(int x, int period)
+{
+    int r = x % period;
+    return r < 0 ? r + period : r;
+}
+
+// 2d Perlin noise in the range about -1 to 1, periodic with px x py cells
+// so that the texture has no seam where u or v wraps around
+// this stays scalar, Vec4f versions over four octaves or over the four corners of the cell
+// were slower, sse2 has no 32-bit multiply for the hash, see procedural_fbm in bench.cpp
+static float perlin(float x, float y, int px, int py)
+{
+    int ix = int(std::floor(x));
+    int iy = int(std::floor(y));
+    float fx = x - ix;
+    float fy = y - iy;
+    int x0 = wrap(ix, px);
+    int x1 = wrap(ix + 1, px);
+    int y0 = wrap(iy, py);
+    int y1 = wrap(iy + 1, py);
+    // quintic fade curves
+    float wx = fx * fx * fx * (fx * (fx * 6 - 15) + 10);
+    float wy = fy * fy * fy * (fy * (fy * 6 - 15) + 10);
+    float n00 = gradient(lattice_hash(x0, y0), fx, fy);
+    float n10 = gradient(lattice_hash(x1, y0), fx - 1, fy);
+    float n01 = gradient(lattice_hash(x0, y1), fx, fy - 1);
+    float n11 = gradient(lattice_hash(x1, y1), fx - 1, fy - 1);
+    float nx0 = n00 + wx * (n10 - n00);
+    float nx1 = n01 + wx * (n11 - n01);
+    return (nx0 + wy * (nx1 - nx0)) * 1.41421356f;
+}
+
+bool Procedural::parseType(const std::string &name, Type &type)
+{
+    if (name == "checker")
+    {
+        type = CHECKER;
+    }
+    else if (name == "stripes")
+    {
+        type = STRIPES;
+    }
+    else if (name == "gradient")
+    {
+        type = GRADIENT;
+    }
+    else if (name == "noise")
+    {
+        type = NOISE;
+    }
+    else if (name == "fbm")
+    {
+        type = FBM;
+    }
+    else
+    {
+        return false;
+    }
+    return true;
+}
+
+float Procedural::pattern(float u, float v, float width) const
+{
+    switch (this->type)
+    {
+        case CHECKER:
+        {
+            // exclusive or of two box-filtered square waves
+            float fu = square_wave(u * this->su, width * std::abs(this->su));
+            float fv = square_wave(v * this->sv, width * std::abs(this->sv));
+            return fu + fv - 2 * fu * fv;
+        }
+        case STRIPES:
+        {
+            float phase = u * this->su + v * this->sv;
+            return square_wave(phase, width * std::sqrt(this->su * this->su + this->sv * this->sv));
+        }
+        case GRADIENT:
+        {
+            float phase = u * this->su + v * this->sv;
+            return phase - std::floor(phase);
+        }
+        case NOISE:
+        case FBM:
+        {
+            int octaves = this->type == NOISE ? 1 : std::max(1, this->octaves);
+            int pu = std::max(1, int(std::round(this->su)));
+            int pv = std::max(1, int(std::round(this->sv)));
+            // footprint in lattice cells of the first octave
+            float cells = width * std::max(pu, pv);
+            float sum = 0;
+            float amplitude = 1;
+            float total = 0;
+            for (int k = 0; k < octaves; k++)
+            {
+                // fade out octaves whose cells are smaller than the footprint,
+                // they would only average to zero
+                float fade = std::min(float(1), std::max(float(0), 2 - 2 * cells));
+                if (fade > 0)
+                {
+                    sum += fade * amplitude * perlin(u * pu, v * pv, pu, pv);
+                }
+                total += amplitude;
+                amplitude *= 0.5;
+                cells *= 2;
+                pu *= 2;
+                pv *= 2;
+            }
+            return std::min(float(1), std::max(float(0), float(0.5 + 0.5 * sum / total)));
+        }
+    }
+    return 0;
+}
+
+Color Procedural::evaluate(float u, float v, float lod) const
+{
+    float t = this->pattern(u, v, std::exp2(lod));
+    return this->c0 * (1 - t) + this->c1 * t;
+}
@@ -0,0 +1,68 @@
+/**
+ * @file procedural.h
+ *
+ * @copyright 2022 Zecheng Qian, All rights reserved.
+ */
+#ifndef SRC_PROCEDURAL_H_
+#define SRC_PROCEDURAL_H_
+
+#include <string>
+#include <cmath>
+#include "color.h"
+
+// a texture evaluated analytically at the texture coordinate, no image is stored
+class Procedural
+{
+    public:
+        // kinds of patterns
+        enum Type
+        {
+            CHECKER,   // su x sv checks
+            STRIPES,   // stripes across the direction (su, sv)
+            GRADIENT,  // linear ramp along the direction (su, sv), repeated
+            NOISE,     // Perlin noise with su x sv lattice cells
+            FBM        // fractional Brownian motion, a sum of noise octaves
+        };
+
+        // constructor
+        Procedural(Type type = CHECKER, float su = 1, float sv = 1,
+                   Color c0 = Color(0, 0, 0), Color c1 = Color(1, 1, 1), int octaves = 5)
+        {
+            this->type = type;
+            this->su = su;
+            this->sv = sv;
+            this->c0 = c0;
+            this->c1 = c1;
+            this->octaves = octaves;
+        }
+
+        // getter
+        Type getType() const { return this->type; }
+        float getSu() const { return this->su; }
+        float getSv() const { return this->sv; }
+        const Color &getC0() const { return this->c0; }
+        const Color &getC1() const { return this->c1; }
+        int getOctaves() const { return this->octaves; }
+
+        // convert a keyword in the scene file to a type, return false if unknown
+        static bool parseType(const std::string &name, Type &type);
+
+        // get the color at texture coordinate (u, v)
+        // lod is the log2 of the footprint width in texture coordinate units, the pattern is
+        // box filtered over the footprint, -INFINITY evaluates it at the point
+        Color evaluate(float u, float v, float lod = -INFINITY) const;
+
+    private:
+        // blending weight between c0 and c1 at (u, v), in the range 0-1
+        float pattern(float u, float v, float width) const;
+
+        Type type;
+        // frequency of the pattern along u and v
+        float su, sv;
+        // the two colors blended by the pattern
+        Color c0, c1;
+        // number of octaves for fbm
+        int octaves;
+};
+
+#endif // SRC_PROCEDURAL_H_
@@ -7,7 +7,5 @@
 
 FloatVec3 Ray::extend(float t) const
 {
-    return FloatVec3(this->center.first + t * this->dir.first,
-                     this->center.second + t * this->dir.second,
-                     this->center.third + t * this->dir.third);
+    return FloatVec3(this->center.simd() + this->dir.simd() * t);
 }
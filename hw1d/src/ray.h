@@ -16,15 +16,23 @@ class Ray
         {
             this->center = FloatVec3(center);
             this->dir = FloatVec3(dir);
+            this->cone_width = 0;
+            this->cone_spread = 0;
         }
 
         // getter
         const FloatVec3 &getCenter() const { return this->center; }
         const FloatVec3 &getDir() const { return this->dir; }
+        float getConeWidth() const { return this->cone_width; }
+        float getConeSpread() const { return this->cone_spread; }
 
         // setter
         void setCenter(const FloatVec3 &center) { this->center = FloatVec3(center); }
         void setDir(const FloatVec3 &dir) { this->dir = FloatVec3(dir); }
+        void setCone(float cone_width, float cone_spread) { this->cone_width = cone_width; this->cone_spread = cone_spread; }
+
+        // width of the ray cone after travelling a distance t along the ray
+        float coneWidth(float t) const { return this->cone_width + this->cone_spread * t; }
 
         // extend the ray and get a point
         FloatVec3 extend(float t) const;
@@ -34,6 +42,9 @@ class Ray
         FloatVec3 center;
         // direction of the ray
         FloatVec3 dir;
+        // ray cone used to select texture mipmap levels
+        // width of the cone at the origin, and its spread angle (in radian)
+        float cone_width, cone_spread;
 };
 
 #endif // SRC_RAY_H_
@@ -0,0 +1,152 @@
+/**
+ * @file raylog.cpp
+ *
+ * @copyright 2022 Zecheng Qian, All rights reserved.
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include "raylog.h"
+#include "mapped_file.h"
+
+// records buffered by a thread before they are written
+#define RAYLOG_BUFFER 8192
+
+namespace
+{
+const char *log_path = getenv("RAYTRACER_RAYLOG");
+std::mutex log_mutex;
+FILE *log_file = NULL;
+bool log_failed = false;
+uint64_t log_count = 0;
+
+// append records to the file, opening it with the first ones
+void write_records(const RayRecord *records, size_t count)
+{
+    std::lock_guard<std::mutex> lock(log_mutex);
+    if (log_failed || count == 0)
+    {
+        return;
+    }
+    if (log_file == NULL)
+    {
+        log_file = fopen(log_path, "wb");
+        if (log_file == NULL)
+        {
+            fprintf(stderr, "Could not open output stream with file %s\n", log_path);
+            log_failed = true;
+            return;
+        }
+        RayLogHeader header;
+        memset(&header, 0, sizeof(header));
+        strncpy(header.magic, RAYLOG_MAGIC, sizeof(header.magic));
+        header.record_size = sizeof(RayRecord);
+        fwrite(&header, sizeof(header), 1, log_file);
+    }
+    fwrite(records, sizeof(RayRecord), count, log_file);
+    log_count += count;
+}
+
+// the records of one thread not yet written, written when it fills up or the thread exits
+struct LogBuffer
+{
+    std::vector<RayRecord> records;
+
+    LogBuffer()
+    {
+        this->records.reserve(RAYLOG_BUFFER);
+    }
+
+    ~LogBuffer()
+    {
+        this->flush();
+    }
+
+    void flush()
+    {
+        write_records(this->records.data(), this->records.size());
+        this->records.clear();
+    }
+};
+
+thread_local LogBuffer log_buffer;
+} // namespace
+
+bool ray_log_enabled()
+{
+    return log_path != NULL && log_path[0] != '\0';
+}
+
+void log_ray(const Ray &ray, RayCategory category, float tmin, float tmax, ObjType obj_type, int obj_idx, float t)
+{
+    RayRecord record;
+    const FloatVec3 &center = ray.getCenter();
+    const FloatVec3 &dir = ray.getDir();
+    record.origin[0] = center.first;
+    record.origin[1] = center.second;
+    record.origin[2] = center.third;
+    record.dir[0] = dir.first;
+    record.dir[1] = dir.second;
+    record.dir[2] = dir.third;
+    record.tmin = tmin;
+    record.tmax = tmax;
+    record.t = t;
+    record.obj_idx = obj_idx;
+    record.category = uint8_t(category);
+    record.obj_type = uint8_t(obj_type);
+    record.reserved = 0;
+    log_buffer.records.push_back(record);
+    if (log_buffer.records.size() >= RAYLOG_BUFFER)
+    {
+        log_buffer.flush();
+    }
+}
+
+void close_ray_log()
+{
+    if (!ray_log_enabled())
+    {
+        return;
+    }
+    log_buffer.flush();
+    std::lock_guard<std::mutex> lock(log_mutex);
+    if (log_file != NULL)
+    {
+        fclose(log_file);
+        log_file = NULL;
+        fprintf(stderr, "%llu rays written to %s\n", (unsigned long long)log_count, log_path);
+    }
+    // rays cast after this are not logged
+    log_failed = true;
+}
+
+bool read_ray_log(const std::string &filename, std::vector<RayRecord> &records)
+{
+    MappedFile file(filename);
+    if (!file.isOpen())
+    {
+        fprintf(stderr, "Could not open input stream with file %s\n", filename.c_str());
+        return false;
+    }
+    RayLogHeader header;
+    if (file.getSize() < sizeof(header))
+    {
+        fprintf(stderr, "%s is not a ray log\n", filename.c_str());
+        return false;
+    }
+    memcpy(&header, file.getData(), sizeof(header));
+    if (strncmp(header.magic, RAYLOG_MAGIC, sizeof(header.magic)) != 0 || header.record_size != sizeof(RayRecord))
+    {
+        fprintf(stderr, "%s is not a ray log of this version\n", filename.c_str());
+        return false;
+    }
+    size_t count = (file.getSize() - sizeof(header)) / sizeof(RayRecord);
+    if (sizeof(header) + count * sizeof(RayRecord) != file.getSize())
+    {
+        fprintf(stderr, "Warning: %s ends with a partial record, it is ignored\n", filename.c_str());
+    }
+    records.resize(count);
+    memcpy(records.data(), file.getData() + sizeof(header), count * sizeof(RayRecord));
+    return true;
+}
@@ -0,0 +1,55 @@
+/**
+ * @file raylog.h
+ *
+ * @copyright 2022 Zecheng Qian, All rights reserved.
+ */
+#ifndef SRC_RAYLOG_H_
+#define SRC_RAYLOG_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "types.h"
+#include "ray.h"
+#include "stats.h"
+
+// a binary log of every ray passed to intersect_check during a render, with the hit it found,
+// recorded when RAYTRACER_RAYLOG names the file to write, and replayed by ./bench --replay
+// the file is a RayLogHeader followed by RayRecords in native byte order
+
+#define RAYLOG_MAGIC "RAYLOG1"
+
+typedef struct RayLogHeaderType
+{
+    char magic[8];
+    uint32_t record_size; // sizeof(RayRecord) of the writer, checked by the reader
+    uint32_t reserved;
+} RayLogHeader;
+
+// one ray, 44 bytes
+typedef struct RayRecordType
+{
+    float origin[3];
+    float dir[3];
+    float tmin, tmax; // the interval searched for hits
+    float t;          // the nearest hit, tmax when nothing was hit
+    int32_t obj_idx;  // the object hit, -1 for none
+    uint8_t category; // a RayCategory
+    uint8_t obj_type; // an ObjType
+    uint16_t reserved;
+} RayRecord;
+
+// whether RAYTRACER_RAYLOG is set
+bool ray_log_enabled();
+
+// append a ray and its hit to the log, records are buffered per thread
+void log_ray(const Ray &ray, RayCategory category, float tmin, float tmax, ObjType obj_type, int obj_idx, float t);
+
+// write the buffered records of the calling thread and close the file,
+// call once the other threads that cast rays have exited
+void close_ray_log();
+
+// read a whole log, false with a message on stderr when it cannot be read
+bool read_ray_log(const std::string &filename, std::vector<RayRecord> &records);
+
+#endif // SRC_RAYLOG_H_
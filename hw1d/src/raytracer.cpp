@@ -7,10 +7,22 @@
 #include <string>
 #include <vector>
 #include <cmath>
+#include <future>
+#include <chrono>
 #include "types.h"
 #include "utils.h"
 #include "scene.h"
 #include "ray.h"
+#include "image.h"
+#include "scene_cache.h"
+#include "parallel.h"
+#include "stats.h"
+#include "heatmap.h"
+#include "trace.h"
+#include "perf_counters.h"
+#include "memory_usage.h"
+#include "raylog.h"
+#include "alloc_profile.h"
 
 
 int main(int argc, char **argv)
@@ -27,36 +39,125 @@ int main(int argc, char **argv)
     int num_keywords = 0;
 
     // get the filename from command line args and parse the file
+    // a binary cache next to the scene file skips parsing and texture decoding on later runs,
+    // set RAYTRACER_CACHE=0 to always parse the text file
     std::string filename = argv[1];
-    num_keywords = scene.parseScene(filename);
+    std::string cache = scene_cache_filename(filename);
+    const char *cache_env = getenv("RAYTRACER_CACHE");
+    bool cache_enable = cache_env == NULL || std::string(cache_env) != "0";
+    bool cache_save = false;
+    bool cache_loaded = false;
+    if (cache_enable)
+    {
+        TraceSpan span("load scene cache", "parse", cache);
+        ALLOC_PHASE(ALLOC_PARSE);
+        PerfScope perf(PERF_PARSE);
+        cache_loaded = load_scene_cache(scene, num_keywords, filename, cache);
+    }
+    if (!cache_loaded)
+    {
+        TraceSpan span("parse scene", "parse", filename);
+        ALLOC_PHASE(ALLOC_PARSE);
+        PerfScope perf(PERF_PARSE);
+        num_keywords = scene.parseScene(filename);
+        cache_save = cache_enable;
+    }
     if (num_keywords < 7) 
     {
         fprintf(stderr, "Missing some keywords! Pleaze recheck your input file!\n");
         exit(-1);
     }
 
+    // write the cache in the background, the scene is not modified while rendering
+    std::future<bool> cache_saved;
+    if (cache_save)
+    {
+        cache_saved = run_async([&scene, num_keywords, &filename, &cache]() {
+            TraceSpan span("save scene cache", "output", cache);
+            ALLOC_PHASE(ALLOC_OUTPUT, true);
+            return save_scene_cache(scene, num_keywords, filename, cache);
+        });
+    }
+
+    ALLOC_PHASE(ALLOC_BUILD);
     // calculate viewwindow parameters, giving a chosen viewing distance
     view_window_init(scene, viewwindow, viewdist);
 
-    // dynamically allocate a 2d array to store pixels in the image
-    Color **checkerboard = new Color *[scene.getWidth()];
-    for (int i = 0; i < scene.getWidth(); i++) 
+    // a contiguous row-major image to store pixels in the image
+    Image<Color> checkerboard(scene.getWidth(), scene.getHeight());
+#ifdef RAYTRACER_STATS
+    std::chrono::steady_clock::time_point render_start = std::chrono::steady_clock::now();
+#endif
+    // the cost of every pixel, when RAYTRACER_HEATMAP asks for it
+    HeatmapMode heatmap = heatmap_mode();
+    Image<float> pixel_cost;
+    if (heatmap != HEATMAP_NONE)
     {
-        checkerboard[i] = new Color[scene.getHeight()];
+        pixel_cost.resize(scene.getWidth(), scene.getHeight());
     }
+    // the counters of every row, when RAYTRACER_PERF asks for them
+    std::vector<PerfCounts> perf_rows(perf_enabled() ? scene.getHeight() : 0);
     // run ray tracing and assign a color for each pixel
-    for (int j = 0; j < scene.getHeight(); j++)
     {
-        for (int i = 0; i < scene.getWidth(); i++) 
+        TraceSpan render_span("render", "render");
+        PerfScope render_perf(PERF_RENDER);
+        ALLOC_PHASE(ALLOC_WARMUP);
+        for (int j = 0; j < scene.getHeight(); j++)
         {
-            Color res_color = trace_ray(scene, viewwindow, i, j);
-            checkerboard[i][j].setR(res_color.getR());
-            checkerboard[i][j].setG(res_color.getG());
-            checkerboard[i][j].setB(res_color.getB());
+            TraceSpan row_span("row", "render", std::string(), j);
+            PerfScope row_perf(PERF_RENDER, perf_rows.empty() ? NULL : &perf_rows[j]);
+            // the first row may create buffers lazily, the others must not allocate
+            ALLOC_PHASE(j == 0 ? ALLOC_WARMUP : ALLOC_RENDER);
+            for (int i = 0; i < scene.getWidth(); i++) 
+            {
+                double cost_start = heatmap != HEATMAP_NONE ? heatmap_counter(heatmap) : 0;
+                checkerboard(i, j) = trace_ray(scene, viewwindow, i, j);
+                if (heatmap != HEATMAP_NONE)
+                {
+                    pixel_cost(i, j) = heatmap_counter(heatmap) - cost_start;
+                }
+            }
         }
     }
 
+#ifdef RAYTRACER_STATS
+    std::chrono::duration<double> render_time = std::chrono::steady_clock::now() - render_start;
+    print_stats(collect_stats(), render_time.count());
+#endif
+
     // produce a final image
-    output_image(filename + ".ppm", checkerboard, scene.getWidth(), scene.getHeight());
+    {
+        TraceSpan span("write image", "output", filename + ".ppm");
+        PerfScope perf(PERF_OUTPUT);
+        ALLOC_PHASE(ALLOC_OUTPUT);
+        output_image(filename + ".ppm", checkerboard, scene.getWidth(), scene.getHeight());
+        if (heatmap != HEATMAP_NONE)
+        {
+            write_heatmap(filename, pixel_cost, heatmap);
+        }
+    }
+    if (cache_saved.valid() && !cache_saved.get())
+    {
+        fprintf(stderr, "Warning: could not write the scene cache %s\n", cache.c_str());
+    }
+    print_perf(perf_rows);
+    if (memory_enabled())
+    {
+        std::vector<MemoryItem> memory;
+        add_scene_memory(memory, scene);
+        add_memory(memory, "framebuffers", "image", checkerboard);
+        add_memory(memory, "framebuffers", "heatmap", pixel_cost);
+        add_memory(memory, "framebuffers", "row counters", perf_rows);
+        report_memory(memory);
+    }
+    close_ray_log();
+    write_trace();
+#ifdef RAYTRACER_ALLOC_PROFILE
+    print_alloc_profile(uint64_t(scene.getWidth()) * scene.getHeight());
+    if (!check_render_allocations())
+    {
+        return 1;
+    }
+#endif
     return 0;
 }
@@ -3,8 +3,73 @@
  *
  * @copyright 2022 Zecheng Qian, All rights reserved.
  */
+#include <future>
+#include <map>
+#include <vector>
 #include "scene.h"
+#include "obj_file.h"
 #include "utils.h"
+#include "mapped_file.h"
+#include "tokenizer.h"
+#include "parallel.h"
+#include "trace.h"
+
+// bulk lines are parsed in parallel chunks of at least this many lines
+#define PARSE_CHUNK 4096
+
+// a line of the scene file, kept as a range into the mapped file
+typedef struct LineSpanType
+{
+    const char *begin, *end;
+} LineSpan;
+
+// a face line, with the material, texture and normal map in effect where it appears
+typedef struct FaceSpanType
+{
+    const char *begin, *end;
+    int m_idx, texture_idx, bump_idx;
+} FaceSpan;
+
+// an OBJ mesh being loaded and the material, texture and normal map in effect where it is imported
+typedef struct MeshImportType
+{
+    std::future<ObjFile> mesh;
+    int m_idx, texture_idx, bump_idx;
+} MeshImport;
+
+// a texture or normal map being decoded in the background, and its slot in the scene list
+template <typename T>
+struct ImageTask
+{
+    size_t idx;
+    std::future<T> image;
+};
+
+// start decoding an image and reserve its slot at the end of the list
+template <typename T>
+static void start_image_task(std::vector<T> &list, std::vector<ImageTask<T> > &tasks,
+                             T (*load)(const std::string &), const std::string &filename)
+{
+    ImageTask<T> task;
+    task.idx = list.size();
+    task.image = run_async([load, filename]() {
+        TraceSpan span("load image", "texture", filename);
+        return load(filename);
+    });
+    list.push_back(T());
+    tasks.push_back(std::move(task));
+}
+
+// wait for the decoded images and move them into their slots
+template <typename T>
+static void finish_image_tasks(std::vector<T> &list, std::vector<ImageTask<T> > &tasks)
+{
+    for (size_t k = 0; k < tasks.size(); k++)
+    {
+        list[tasks[k].idx] = tasks[k].image.get();
+    }
+    tasks.clear();
+}
 
 Scene::Scene()
 {
@@ -18,120 +83,300 @@ Scene::Scene()
     this->depth_cue_enable = false;
 }
 
+// read n floats from the tokenizer, return the number actually read
+static int read_floats(Tokenizer &tok, float *float_var, int n)
+{
+    for (int k = 0; k < n; k++)
+    {
+        if (!tok.readFloat(float_var[k]))
+        {
+            return k;
+        }
+    }
+    return n;
+}
+
+// read the header of a P3 ppm image: width, height and maximum color value
+static bool read_ppm_header(Tokenizer &tok, int *int_var)
+{
+    std::string magic;
+    return tok.readString(magic) && tok.readInt(int_var[0]) && tok.readInt(int_var[1]) && tok.readInt(int_var[2]);
+}
+
+// load a texture image in P3 ppm format
+static Texture load_texture(const std::string &filename)
+{
+    int int_var[6];
+    MappedFile file(filename);
+    Tokenizer tok(file.begin(), file.end());
+    if (!file.isOpen() || !read_ppm_header(tok, int_var))
+    {
+        fprintf(stderr, "Could not read texture file %s\n", filename.c_str());
+        return Texture(1, 1);
+    }
+    Texture texture(int_var[0], int_var[1], int_var[2]);
+    TiledImage<Rgba8> &checkerboard = texture.getCheckerboard();
+    for (int j = 0; j < texture.getHeight(); j++)
+    {
+        for (int i = 0; i < texture.getWidth(); i++)
+        {
+            int_var[3] = int_var[4] = int_var[5] = 0;
+            tok.readInt(int_var[3]) && tok.readInt(int_var[4]) && tok.readInt(int_var[5]);
+            Rgba8 &texel = checkerboard(i, j);
+            texel.r = texture.encode(int_var[3]);
+            texel.g = texture.encode(int_var[4]);
+            texel.b = texture.encode(int_var[5]);
+            texel.a = MAX_VAL;
+        }
+    }
+    texture.buildMipmap();
+    return texture;
+}
+
+// load a normal map in P3 ppm format
+static Bump load_bump(const std::string &filename)
+{
+    int int_var[6];
+    MappedFile file(filename);
+    Tokenizer tok(file.begin(), file.end());
+    if (!file.isOpen() || !read_ppm_header(tok, int_var))
+    {
+        fprintf(stderr, "Could not read normal map file %s\n", filename.c_str());
+        return Bump(1, 1);
+    }
+    Bump bump(int_var[0], int_var[1], int_var[2]);
+    TiledImage<OctNormal> &checkerboard = bump.getCheckerboard();
+    for (int j = 0; j < bump.getHeight(); j++)
+    {
+        for (int i = 0; i < bump.getWidth(); i++)
+        {
+            int_var[3] = int_var[4] = int_var[5] = 0;
+            tok.readInt(int_var[3]) && tok.readInt(int_var[4]) && tok.readInt(int_var[5]);
+            checkerboard(i, j) = OctNormal(FloatVec3(int_var[3] * 1.0 / bump.getMaxVal() * 2 - 1,
+                                                     int_var[4] * 1.0 / bump.getMaxVal() * 2 - 1,
+                                                     int_var[5] * 1.0 / bump.getMaxVal() * 2 - 1));
+        }
+    }
+    bump.buildMipmap();
+    return bump;
+}
+
+// parse one vertex reference of a face, in the format v, v/vt, v//vn or v/vt/vn
+// missing indices are left to -1
+static bool read_face_vertex(Tokenizer &tok, int &v, int &vt, int &vn)
+{
+    vt = -1;
+    vn = -1;
+    if (!tok.readInt(v))
+    {
+        return false;
+    }
+    if (tok.accept('/'))
+    {
+        if (!tok.accept('/'))
+        {
+            if (!tok.readInt(vt))
+            {
+                return false;
+            }
+            if (!tok.accept('/'))
+            {
+                return true;
+            }
+        }
+        if (!tok.readInt(vn))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// parse a face line into the vertex indices and the shading attributes of a triangle
+// indices in the file start from 1, they are stored from 0
+// the first vertex index is left to -1 if the line is malformed
+static void parse_face(const FaceSpan &span, TriangleVertices &vertices, Triangle &triangle)
+{
+    Tokenizer tok(span.begin, span.end);
+    const char *word;
+    size_t len;
+    int v[3], vt[3], vn[3];
+    vertices.v0 = -1;
+    tok.readWord(word, len);
+    for (int k = 0; k < 3; k++)
+    {
+        if (!read_face_vertex(tok, v[k], vt[k], vn[k]))
+        {
+            return;
+        }
+        // all three vertices need to use the same format
+        if ((vt[k] == -1) != (vt[0] == -1) || (vn[k] == -1) != (vn[0] == -1))
+        {
+            return;
+        }
+    }
+    vertices.v0 = v[0] - 1;
+    vertices.v1 = v[1] - 1;
+    vertices.v2 = v[2] - 1;
+    triangle = Triangle(span.m_idx, span.texture_idx, span.bump_idx);
+    if (vn[0] != -1)
+    {
+        // smooth shading applied, the format has a vn part
+        triangle.setVn0idx(vn[0] - 1);
+        triangle.setVn1idx(vn[1] - 1);
+        triangle.setVn2idx(vn[2] - 1);
+    }
+    if (vt[0] != -1)
+    {
+        // texture mapping applied, the format has a vt part
+        triangle.setVt0idx(vt[0] - 1);
+        triangle.setVt1idx(vt[1] - 1);
+        triangle.setVt2idx(vt[2] - 1);
+    }
+}
+
 int Scene::parseScene(std::string filename)
 {
-    std::ifstream inputstream(filename, std::ios::in | std::ios::binary);
+    MappedFile file(filename);
 
-    if (!inputstream.is_open())
+    if (!file.isOpen())
     {
         fprintf(stderr, "Could not open input stream with file %s\n", filename.c_str());
+        return 0;
     }
 
-    std::string keyword;
-    std::string line;
     int int_var[20];
     float float_var[20];
-    char str_var[10][50];
     int m_idx = -1;
     int texture_idx = -1;
     int bump_idx = -1;
     int obj_sphere_idx = 0;
     int obj_cylinder_idx = 0;
-    int obj_vertex_idx = 1;  // vertex index starts from 1
-    int obj_vertex_normal_idx = 1;  // vertex normal index starts from 1
-    int obj_texture_coordinate_idx = 1;  // texture coordinate index starts from 1
-    int obj_triangle_idx = 0;
     int num_keywords = 0;
+    // bulk geometry lines, parsed in parallel once the whole file is scanned
+    std::vector<LineSpan> vertex_lines;
+    std::vector<LineSpan> vertex_normal_lines;
+    std::vector<LineSpan> texture_coordinate_lines;
+    std::vector<FaceSpan> face_lines;
+    // meshes imported with objfile, and textures and normal maps, are loaded in the
+    // background while the scan and the geometry parsing go on
+    std::vector<MeshImport> mesh_imports;
+    std::vector<ImageTask<Texture> > texture_tasks;
+    std::vector<ImageTask<Bump> > bump_tasks;
 
-    // read and process line by line
-    while (std::getline(inputstream, line))
+    // scan line by line, the file is tokenized in place
+    Tokenizer scanner(file.begin(), file.end());
+    while (!scanner.done())
     {
-        // initialize the keywork to empty
-        keyword = "";
-        // convert the string line to input string stream
-        std::istringstream iss(line);
-        iss >> keyword;
-        // check keywords
-        if (keyword == "eye")
+        const char *line_begin, *line_end;
+        scanner.nextLine(line_begin, line_end);
+        Tokenizer iss(line_begin, line_end);
+        const char *keyword;
+        size_t len;
+        if (!iss.readWord(keyword, len))
+        {
+            continue;
+        }
+        // check keywords, the geometry keywords come first as they are the most frequent
+        if (word_equal(keyword, len, "v"))
+        {
+            num_keywords++;
+            LineSpan span = {line_begin, line_end};
+            vertex_lines.push_back(span);
+        }
+        else if (word_equal(keyword, len, "vn"))
+        {
+            num_keywords++;
+            LineSpan span = {line_begin, line_end};
+            vertex_normal_lines.push_back(span);
+        }
+        else if (word_equal(keyword, len, "vt"))
+        {
+            num_keywords++;
+            LineSpan span = {line_begin, line_end};
+            texture_coordinate_lines.push_back(span);
+        }
+        else if (word_equal(keyword, len, "f"))
+        {
+            num_keywords++;
+            // remember the current material, texture and normal map for this face
+            FaceSpan span = {line_begin, line_end, m_idx, texture_idx, bump_idx};
+            face_lines.push_back(span);
+        }
+        else if (word_equal(keyword, len, "eye"))
         {
             num_keywords++;
             // read the world coordinate of the eye
-            iss >> float_var[0] >> float_var[1] >> float_var[2];
+            read_floats(iss, float_var, 3);
             FloatVec3 eye(float_var[0], float_var[1], float_var[2]);
             this->eye = eye;
         }
-        else if (keyword == "viewdir")
+        else if (word_equal(keyword, len, "viewdir"))
         {
             num_keywords++;
             // read the world coordinate of the view direction
-            iss >> float_var[0] >> float_var[1] >> float_var[2];
+            read_floats(iss, float_var, 3);
             FloatVec3 viewdir(float_var[0], float_var[1], float_var[2]);
             this->viewdir = viewdir;
         }
-        else if (keyword == "updir")
+        else if (word_equal(keyword, len, "updir"))
         {
             num_keywords++;
             // read the world coordinate of the up direction
-            iss >> float_var[0] >> float_var[1] >> float_var[2];
+            read_floats(iss, float_var, 3);
             FloatVec3 updir(float_var[0], float_var[1], float_var[2]);
             this->updir = updir;
         }
-        else if (keyword == "vfov")
+        else if (word_equal(keyword, len, "vfov"))
         {
             num_keywords++;
             // read the vertical field of view (in degree)
-            iss >> float_var[0];
+            read_floats(iss, float_var, 1);
             this->vfov = float_var[0];
         }
-        else if (keyword == "imsize")
+        else if (word_equal(keyword, len, "imsize"))
         {
             num_keywords++;
             // read width and height of the image
-            iss >> int_var[0] >> int_var[1];
+            iss.readInt(int_var[0]);
+            iss.readInt(int_var[1]);
             this->width = int_var[0];
             this->height = int_var[1];
         }
-        else if (keyword == "bkgcolor")
+        else if (word_equal(keyword, len, "bkgcolor"))
         {
             num_keywords++;
             // read the background color
-            iss >> float_var[0] >> float_var[1] >> float_var[2];
+            read_floats(iss, float_var, 3);
             Color bkgcolor(float_var[0], float_var[1], float_var[2]);
             this->bkgcolor = bkgcolor;
         }
-        else if (keyword == "light")
+        else if (word_equal(keyword, len, "light"))
         {
             num_keywords++;
             // read in the light source
-            iss >> float_var[0] >> float_var[1] >> float_var[2]
-                >> float_var[3] >> float_var[4] >> float_var[5]
-                >> float_var[6];
+            read_floats(iss, float_var, 7);
             Light light(float_var[0], float_var[1], float_var[2],
                         float_var[3], float_var[4], float_var[5],
                         float_var[6]);
             this->light_list.push_back(light);
         }
-        else if (keyword == "attlight")
+        else if (word_equal(keyword, len, "attlight"))
         {
             num_keywords++;
             // read in the light source
-            iss >> float_var[0] >> float_var[1] >> float_var[2] 
-                >> float_var[3] >> float_var[4] >> float_var[5] 
-                >> float_var[6] >> float_var[7] >> float_var[8]
-                >> float_var[9];
+            read_floats(iss, float_var, 10);
             AttLight attlight(float_var[0], float_var[1], float_var[2],
                               float_var[3], float_var[4], float_var[5],
                               float_var[6], float_var[7], float_var[8],
                               float_var[9]);
             this->attlight_list.push_back(attlight);
         }
-        else if (keyword == "depthcueing")
+        else if (word_equal(keyword, len, "depthcueing"))
         {
             num_keywords++;
             // read in the light source
-            iss >> float_var[0] >> float_var[1] >> float_var[2] 
-                >> float_var[3] >> float_var[4] >> float_var[5] 
-                >> float_var[6];
+            read_floats(iss, float_var, 7);
             DepthCue depth_cue = {
                 .dc_r = float_var[0],
                 .dc_g = float_var[1],
@@ -143,15 +388,12 @@ int Scene::parseScene(std::string filename)
             this->depth_cue = depth_cue;
             this->depth_cue_enable = true;
         }
-        else if (keyword == "mtlcolor")
+        else if (word_equal(keyword, len, "mtlcolor"))
         {
             num_keywords++;
             // update the current material color
             m_idx++;
-            iss >> float_var[0] >> float_var[1] >> float_var[2]
-                >> float_var[3] >> float_var[4] >> float_var[5]
-                >> float_var[6] >> float_var[7] >> float_var[8]
-                >> float_var[9] >> float_var[10] >> float_var[11];
+            read_floats(iss, float_var, 12);
             MaterialColor material(Color(float_var[0], float_var[1], float_var[2]),
                                    Color(float_var[3], float_var[4], float_var[5]),
                                    float_var[6],
@@ -162,77 +404,96 @@ int Scene::parseScene(std::string filename)
                                    float_var[11]);
             this->material_list.push_back(material);
         }
-        else if (keyword == "texture")
+        else if (word_equal(keyword, len, "texture"))
         {
             num_keywords++;
             // read in the filename for the texture file
-            if (sscanf(line.c_str(), "texture %s", str_var[0]) == 1)
+            std::string texture_filename;
+            if (iss.readString(texture_filename))
+            {
+                // update the current texture
+                texture_idx++;
+                this->dependency_list.push_back(texture_filename);
+                start_image_task(this->texture_list, texture_tasks, load_texture, texture_filename);
+            }
+        }
+        else if (word_equal(keyword, len, "proctexture"))
+        {
+            num_keywords++;
+            // read in a procedural texture: type, frequencies along u and v, two colors
+            // and optionally the number of octaves for fbm
+            std::string name;
+            Procedural::Type type;
+            iss.readString(name);
+            read_floats(iss, float_var, 8);
+            if (!iss.readInt(int_var[0]))
+            {
+                int_var[0] = 5;
+            }
+            if (Procedural::parseType(name, type))
             {
-                // update the current material color
+                // update the current texture
                 texture_idx++;
-                // open the texture image and bind it to a input stream
-                std::ifstream texture_inputstream(str_var[0], std::ios::in | std::ios::binary);
-                // read the header information
-                texture_inputstream >> str_var[1] >> int_var[0] >> int_var[1] >> int_var[2];
-                Texture texture(int_var[0], int_var[1], int_var[2]);
-                Color **checkerboard = texture.getCheckerboard();
-                for (int j = 0; j < texture.getHeight(); j++)
-                {
-                    for (int i = 0; i < texture.getWidth(); i++)
-                    {
-                        texture_inputstream >> int_var[3] >> int_var[4] >> int_var[5];
-                        checkerboard[i][j].setR(int_var[3] * 1.0 / texture.getMaxVal());
-                        checkerboard[i][j].setG(int_var[4] * 1.0 / texture.getMaxVal());
-                        checkerboard[i][j].setB(int_var[5] * 1.0 / texture.getMaxVal());
-                    }
-                }
-                this->texture_list.push_back(texture);
+                Procedural procedural(type, float_var[0], float_var[1],
+                                      Color(float_var[2], float_var[3], float_var[4]),
+                                      Color(float_var[5], float_var[6], float_var[7]),
+                                      int_var[0]);
+                this->texture_list.push_back(Texture(procedural));
+            }
+            else
+            {
+                fprintf(stderr, "Unknown procedural texture %s\n", name.c_str());
             }
         }
-        else if (keyword == "bump")
+        else if (word_equal(keyword, len, "bump"))
         {
             num_keywords++;
             // read in the filename for the normal map
-            if (sscanf(line.c_str(), "bump %s", str_var[0]) == 1)
+            std::string bump_filename;
+            if (iss.readString(bump_filename))
             {
-                // update the current material color
+                // update the current normal map
                 bump_idx++;
-                // open the texture image and bind it to a input stream
-                std::ifstream bump_inputstream(str_var[0], std::ios::in | std::ios::binary);
-                // read the header information
-                bump_inputstream >> str_var[1] >> int_var[0] >> int_var[1] >> int_var[2];
-                Bump bump(int_var[0], int_var[1], int_var[2]);
-                FloatVec3 **checkerboard = bump.getCheckerboard();
-                for (int j = 0; j < bump.getHeight(); j++)
-                {
-                    for (int i = 0; i < bump.getWidth(); i++)
-                    {
-                        bump_inputstream >> int_var[3] >> int_var[4] >> int_var[5];
-                        checkerboard[i][j].first = (int_var[3] * 1.0 / bump.getMaxVal() * 2 - 1);
-                        checkerboard[i][j].second = (int_var[4] * 1.0 / bump.getMaxVal() * 2 - 1);
-                        checkerboard[i][j].third = (int_var[5] * 1.0 / bump.getMaxVal() * 2 - 1);
-                    }
-                }
-                this->bump_list.push_back(bump);
+                this->dependency_list.push_back(bump_filename);
+                start_image_task(this->bump_list, bump_tasks, load_bump, bump_filename);
+            }
+        }
+        else if (word_equal(keyword, len, "objfile"))
+        {
+            num_keywords++;
+            // read in an external OBJ mesh, it is appended after the inline geometry
+            std::string mesh_filename;
+            if (iss.readString(mesh_filename))
+            {
+                MeshImport mesh_import;
+                mesh_import.m_idx = m_idx;
+                mesh_import.texture_idx = texture_idx;
+                mesh_import.bump_idx = bump_idx;
+                this->dependency_list.push_back(mesh_filename);
+                mesh_import.mesh = run_async([mesh_filename]() {
+                    TraceSpan span("load mesh", "parse", mesh_filename);
+                    ObjFile mesh;
+                    mesh.load(mesh_filename);
+                    return mesh;
+                });
+                mesh_imports.push_back(std::move(mesh_import));
             }
         }
-        else if (keyword == "sphere")
+        else if (word_equal(keyword, len, "sphere"))
         {
             num_keywords++;
             // store parameters for the sphere
-            iss >> float_var[0] >> float_var[1] >> float_var[2] >> float_var[3];
+            read_floats(iss, float_var, 4);
             Sphere sphere(obj_sphere_idx++, m_idx, texture_idx, bump_idx,
                           FloatVec3(float_var[0], float_var[1], float_var[2]),
                           float_var[3]);
             this->sphere_list.push_back(sphere);
         }
-        else if (keyword == "cylinder")
+        else if (word_equal(keyword, len, "cylinder"))
         {
             num_keywords++;
             // store parameters for the cylinder
-            iss >> float_var[0] >> float_var[1] >> float_var[2] 
-                        >> float_var[3] >> float_var[4] >> float_var[5]
-                        >> float_var[6] >> float_var[7];
+            read_floats(iss, float_var, 8);
             Cylinder cylinder(obj_cylinder_idx++,
                               m_idx,
                               texture_idx,
@@ -243,124 +504,187 @@ int Scene::parseScene(std::string filename)
                               float_var[7]);
             this->cylinder_list.push_back(cylinder);
         }
-        else if (keyword == "v")
+    }
+
+    // parse the geometry in parallel, every line already knows its slot in the lists
+    // vertex, vertex normal and texture coordinate indices start from 1
+    this->vertex_list.resize(vertex_lines.size());
+    parallel_for(vertex_lines.size(), PARSE_CHUNK, [&](size_t begin, size_t end) {
+        TraceSpan span("parse vertices", "parse");
+        float xyz[3];
+        for (size_t k = begin; k < end; k++)
         {
-            num_keywords++;
-            // store parameters for the vertex
-            iss >> float_var[0] >> float_var[1] >> float_var[2];
-            Vertex vertex = {
-                .obj_idx = obj_vertex_idx++,
-                .p = FloatVec3(float_var[0], float_var[1], float_var[2])};
-            this->vertex_list.push_back(vertex);
+            Tokenizer tok(vertex_lines[k].begin + 1, vertex_lines[k].end);
+            xyz[0] = xyz[1] = xyz[2] = 0;
+            read_floats(tok, xyz, 3);
+            this->vertex_list[k] = FloatVec3(xyz[0], xyz[1], xyz[2]);
         }
-        else if (keyword == "vn")
+    });
+    this->vertex_normal_list.resize(vertex_normal_lines.size());
+    parallel_for(vertex_normal_lines.size(), PARSE_CHUNK, [&](size_t begin, size_t end) {
+        TraceSpan span("parse vertex normals", "parse");
+        float xyz[3];
+        for (size_t k = begin; k < end; k++)
         {
-            num_keywords++;
-            // store parameters for the vertex normal
-            iss >> float_var[0] >> float_var[1] >> float_var[2];
-            VertexNormal vertex_normal = {
-                .obj_idx = obj_vertex_normal_idx++,
-                .n = FloatVec3(float_var[0], float_var[1], float_var[2]).normal()};
-            this->vertex_normal_list.push_back(vertex_normal);
+            Tokenizer tok(vertex_normal_lines[k].begin + 2, vertex_normal_lines[k].end);
+            xyz[0] = xyz[1] = xyz[2] = 0;
+            read_floats(tok, xyz, 3);
+            this->vertex_normal_list[k] = FloatVec3(xyz[0], xyz[1], xyz[2]).normal();
         }
-        else if (keyword == "vt")
+    });
+    this->texture_coordinate_list.resize(texture_coordinate_lines.size());
+    parallel_for(texture_coordinate_lines.size(), PARSE_CHUNK, [&](size_t begin, size_t end) {
+        TraceSpan span("parse texture coordinates", "parse");
+        float uv[2];
+        for (size_t k = begin; k < end; k++)
         {
-            num_keywords++;
-            // store parameters for the texture coordinate
-            iss >> float_var[0] >> float_var[1];
-            TextureCoordinate texture_coordinate = {
-                .obj_idx = obj_texture_coordinate_idx++,
-                .vt = FloatVec2(float_var[0], float_var[1])};
-            this->texture_coordinate_list.push_back(texture_coordinate);
+            Tokenizer tok(texture_coordinate_lines[k].begin + 2, texture_coordinate_lines[k].end);
+            uv[0] = uv[1] = 0;
+            read_floats(tok, uv, 2);
+            this->texture_coordinate_list[k] = FloatVec2(uv[0], uv[1]);
         }
-        else if (keyword == "f")
+    });
+    std::vector<TriangleVertices> triangle_vertices(face_lines.size());
+    std::vector<Triangle> triangles(face_lines.size());
+    parallel_for(face_lines.size(), PARSE_CHUNK, [&](size_t begin, size_t end) {
+        TraceSpan span("parse faces", "parse");
+        for (size_t k = begin; k < end; k++)
         {
-            num_keywords++;
-            // check the input format specified by the user
-            // whether it uses smooth shading, whether it uses texture mapping
-            if (sscanf(line.c_str(), "f %d %d %d", int_var, int_var + 1, int_var + 2) == 3)
-            {
-                // simple flat shading, use the format v
-                // smooth shading not applied
-                // texture mappign not applied
-                Triangle triangle;
-                triangle.setID(obj_triangle_idx++);
-                triangle.setMidx(m_idx);
-                triangle.setTextureidx(-1);
-                triangle.setBumpidx(bump_idx);
-                triangle.setV0idx(int_var[0]);
-                triangle.setV1idx(int_var[1]);
-                triangle.setV2idx(int_var[2]);
-                this->triangle_list.push_back(triangle);
-            }
-            else if (sscanf(line.c_str(), "f %d//%d %d//%d %d//%d", 
-                            int_var, int_var + 1, int_var + 2,
-                            int_var + 3, int_var + 4, int_var + 5) == 6)
-            {
-                // only smooth shading enabled, use the format v//vn
-                // smooth shading applied
-                // texture mappign not applied
-                Triangle triangle;
-                triangle.setID(obj_triangle_idx++);
-                triangle.setMidx(m_idx);
-                triangle.setTextureidx(-1);
-                triangle.setBumpidx(bump_idx);
-                triangle.setV0idx(int_var[0]);
-                triangle.setV1idx(int_var[2]);
-                triangle.setV2idx(int_var[4]);
-                triangle.setSmoothShade(true);
-                triangle.setVn0idx(int_var[1]);
-                triangle.setVn1idx(int_var[3]);
-                triangle.setVn2idx(int_var[5]);
-                this->triangle_list.push_back(triangle);
-            }
-            else if (sscanf(line.c_str(), "f %d/%d %d/%d %d/%d", 
-                            int_var, int_var + 1, int_var + 2,
-                            int_var + 3, int_var + 4, int_var + 5) == 6)
+            parse_face(face_lines[k], triangle_vertices[k], triangles[k]);
+        }
+    });
+    // drop malformed faces
+    this->triangle_vertex_list.reserve(this->triangle_vertex_list.size() + triangles.size());
+    this->triangle_list.reserve(this->triangle_list.size() + triangles.size());
+    for (size_t k = 0; k < triangles.size(); k++)
+    {
+        if (triangle_vertices[k].v0 != -1)
+        {
+            this->triangle_vertex_list.push_back(triangle_vertices[k]);
+            this->triangle_list.push_back(triangles[k]);
+        }
+    }
+    // collect the background loads, a mesh that failed to load is empty
+    TraceSpan span("wait for background loads", "texture");
+    finish_image_tasks(this->texture_list, texture_tasks);
+    finish_image_tasks(this->bump_list, bump_tasks);
+    for (size_t k = 0; k < mesh_imports.size(); k++)
+    {
+        this->importMesh(mesh_imports[k].mesh.get(), mesh_imports[k].m_idx,
+                         mesh_imports[k].texture_idx, mesh_imports[k].bump_idx);
+    }
+
+    return num_keywords;
+}
+
+// whether a filename ends with the ppm extension, the only image format supported
+static bool is_ppm(const std::string &filename)
+{
+    size_t dot = filename.find_last_of('.');
+    if (dot == std::string::npos)
+    {
+        return false;
+    }
+    std::string ext = filename.substr(dot + 1);
+    for (size_t k = 0; k < ext.size(); k++)
+    {
+        ext[k] = tolower(ext[k]);
+    }
+    return ext == "ppm";
+}
+
+void Scene::importMesh(const ObjFile &mesh, int m_idx, int texture_idx, int bump_idx)
+{
+    // indices of the mesh are shifted past the geometry already in the scene
+    int v_offset = this->vertex_list.size();
+    int vn_offset = this->vertex_normal_list.size();
+    int vt_offset = this->texture_coordinate_list.size();
+    this->vertex_list.insert(this->vertex_list.end(),
+                             mesh.getVertexList().begin(), mesh.getVertexList().end());
+    this->vertex_normal_list.insert(this->vertex_normal_list.end(),
+                                    mesh.getVertexNormalList().begin(), mesh.getVertexNormalList().end());
+    this->texture_coordinate_list.insert(this->texture_coordinate_list.end(),
+                                         mesh.getTextureCoordinateList().begin(), mesh.getTextureCoordinateList().end());
+
+    // convert the MTL materials, a texture shared by several materials is loaded once
+    // the diffuse and specular colors go to Od and Os with unit weights, and a small
+    // ambient term keeps the parts in shadow visible as MTL files rarely set Ka
+    std::vector<int> material_m_idx, material_texture_idx, material_bump_idx;
+    std::map<std::string, int> texture_files, bump_files;
+    this->dependency_list.insert(this->dependency_list.end(),
+                                 mesh.getLibraryList().begin(), mesh.getLibraryList().end());
+    std::vector<ImageTask<Texture> > texture_tasks;
+    std::vector<ImageTask<Bump> > bump_tasks;
+    for (size_t k = 0; k < mesh.getMaterialList().size(); k++)
+    {
+        const ObjMaterial &obj_material = mesh.getMaterialList()[k];
+        MaterialColor material(obj_material.Kd, obj_material.Ks, 0.1, 1, 1,
+                               obj_material.Ns, obj_material.d, obj_material.Ni);
+        material_m_idx.push_back(this->material_list.size());
+        this->material_list.push_back(material);
+        int material_texture = -1;
+        if (!obj_material.map_Kd.empty() && is_ppm(obj_material.map_Kd))
+        {
+            if (texture_files.count(obj_material.map_Kd) == 0)
             {
-                // only texture mapping enabled, use the format v/vt
-                // smooth shading not applied
-                // texture mapping applied
-                Triangle triangle;
-                triangle.setID(obj_triangle_idx++);
-                triangle.setMidx(m_idx);
-                triangle.setTextureidx(texture_idx);
-                triangle.setBumpidx(bump_idx);
-                triangle.setV0idx(int_var[0]);
-                triangle.setV1idx(int_var[2]);
-                triangle.setV2idx(int_var[4]);
-                triangle.setTextureMap(true);
-                triangle.setVt0idx(int_var[1]);
-                triangle.setVt1idx(int_var[3]);
-                triangle.setVt2idx(int_var[5]);
-                this->triangle_list.push_back(triangle);
+                texture_files[obj_material.map_Kd] = this->texture_list.size();
+                this->dependency_list.push_back(obj_material.map_Kd);
+                start_image_task(this->texture_list, texture_tasks, load_texture, obj_material.map_Kd);
             }
-            else if (sscanf(line.c_str(), "f %d/%d/%d %d/%d/%d %d/%d/%d", 
-                            int_var, int_var + 1, int_var + 2,
-                            int_var + 3, int_var + 4, int_var + 5,
-                            int_var + 6, int_var + 7, int_var + 8) == 9)
+            material_texture = texture_files[obj_material.map_Kd];
+        }
+        else if (!obj_material.map_Kd.empty())
+        {
+            fprintf(stderr, "Skipping texture %s, only ppm images are supported\n", obj_material.map_Kd.c_str());
+        }
+        material_texture_idx.push_back(material_texture);
+        int material_bump = -1;
+        if (!obj_material.map_bump.empty() && is_ppm(obj_material.map_bump))
+        {
+            if (bump_files.count(obj_material.map_bump) == 0)
             {
-                // smooth shading, and texture mapping, use the format v/vt/vn
-                Triangle triangle;
-                triangle.setID(obj_triangle_idx++);
-                triangle.setMidx(m_idx);
-                triangle.setTextureidx(texture_idx);
-                triangle.setBumpidx(bump_idx);
-                triangle.setV0idx(int_var[0]);
-                triangle.setV1idx(int_var[3]);
-                triangle.setV2idx(int_var[6]);
-                triangle.setSmoothShade(true);
-                triangle.setVn0idx(int_var[2]);
-                triangle.setVn1idx(int_var[5]);
-                triangle.setVn2idx(int_var[8]);
-                triangle.setTextureMap(true);
-                triangle.setVt0idx(int_var[1]);
-                triangle.setVt1idx(int_var[4]);
-                triangle.setVt2idx(int_var[7]);
-                this->triangle_list.push_back(triangle);
+                bump_files[obj_material.map_bump] = this->bump_list.size();
+                this->dependency_list.push_back(obj_material.map_bump);
+                start_image_task(this->bump_list, bump_tasks, load_bump, obj_material.map_bump);
             }
+            material_bump = bump_files[obj_material.map_bump];
+        }
+        else if (!obj_material.map_bump.empty())
+        {
+            fprintf(stderr, "Skipping normal map %s, only ppm images are supported\n", obj_material.map_bump.c_str());
         }
+        material_bump_idx.push_back(material_bump);
+    }
+    finish_image_tasks(this->texture_list, texture_tasks);
+    finish_image_tasks(this->bump_list, bump_tasks);
+
+    this->triangle_vertex_list.reserve(this->triangle_vertex_list.size() + mesh.getTriangleList().size());
+    this->triangle_list.reserve(this->triangle_list.size() + mesh.getTriangleList().size());
+    for (size_t k = 0; k < mesh.getTriangleList().size(); k++)
+    {
+        const ObjTriangle &face = mesh.getTriangleList()[k];
+        int face_m_idx = m_idx, face_texture_idx = texture_idx, face_bump_idx = bump_idx;
+        if (face.material != -1)
+        {
+            face_m_idx = material_m_idx[face.material];
+            face_texture_idx = material_texture_idx[face.material];
+            face_bump_idx = material_bump_idx[face.material];
+        }
+        // normal maps need texture coordinates
+        if (face.vt[0] == -1)
+        {
+            face_bump_idx = -1;
+        }
+        TriangleVertices vertices = {face.v[0] + v_offset, face.v[1] + v_offset, face.v[2] + v_offset};
+        this->triangle_vertex_list.push_back(vertices);
+        int vn[3], vt[3];
+        for (int c = 0; c < 3; c++)
+        {
+            vn[c] = face.vn[c] == -1 ? -1 : face.vn[c] + vn_offset;
+            vt[c] = face.vt[c] == -1 ? -1 : face.vt[c] + vt_offset;
+        }
+        Triangle triangle(face_m_idx, face_texture_idx, face_bump_idx,
+                          vn[0], vn[1], vn[2], vt[0], vt[1], vt[2]);
+        this->triangle_list.push_back(triangle);
     }
-    inputstream.close();
-    return num_keywords;
 }
@@ -10,6 +10,8 @@
 #include <fstream>
 #include <string>
 #include <sstream>
+#include <utility>
+#include <vector>
 #include "types.h"
 #include "color.h"
 #include "material_color.h"
@@ -20,6 +22,7 @@
 #include "triangle.h"
 
 class Triangle;
+class ObjFile;
 
 class Scene
 {
@@ -40,16 +43,18 @@ class Scene
         const std::vector<Bump> &getBumpList() const { return this->bump_list; }
         const std::vector<Sphere> &getSphereList() const { return this->sphere_list; }
         const std::vector<Cylinder> &getCylinderList() const { return this->cylinder_list; }
-        const std::vector<Vertex> &getVertexList() const { return this->vertex_list; }
-        const std::vector<VertexNormal> &getVertexNormalList() const { return this->vertex_normal_list; }
-        const std::vector<TextureCoordinate> &getTextureCoordinateList() const { return this->texture_coordinate_list; }
+        const std::vector<FloatVec3> &getVertexList() const { return this->vertex_list; }
+        const std::vector<FloatVec3> &getVertexNormalList() const { return this->vertex_normal_list; }
+        const std::vector<FloatVec2> &getTextureCoordinateList() const { return this->texture_coordinate_list; }
+        const std::vector<TriangleVertices> &getTriangleVertexList() const { return this->triangle_vertex_list; }
         const std::vector<Triangle> &getTriangleList() const { return this->triangle_list; }
         const std::vector<Light> &getLightList() const { return this->light_list; }
         const std::vector<AttLight> &getAttLightList() const { return this->attlight_list; }
         const DepthCue &getDepthCue() const { return this->depth_cue; }
         bool depthCueEnable() const { return this->depth_cue_enable; }
+        const std::vector<std::string> &getDependencyList() const { return this->dependency_list; }
 
-        // setters
+        // setters, the lists are moved in rather than copied
         void setEye(const FloatVec3 &eye) { this->eye = FloatVec3(eye); }
         void setViewdir(const FloatVec3 &viewdir) { this->viewdir = FloatVec3(viewdir); }
         void setUpdir(const FloatVec3 &updir) { this->updir = FloatVec3(updir); }
@@ -57,23 +62,30 @@ class Scene
         void setVfov(float vfov) { this->vfov = vfov; }
         void setWidth(int width) { this->width = width; }
         void setHeight(int height) { this->height = height; }
-        void setMaterialList(const std::vector<MaterialColor> &material_list) { this->material_list = std::vector<MaterialColor>(material_list); }
-        void setTextureList(const std::vector<Texture> &texture_list) { this->texture_list = std::vector<Texture>(texture_list); }
-        void setBumpList(const std::vector<Bump> &bump_list) { this->bump_list = std::vector<Bump>(bump_list); }
-        void setSphereList(const std::vector<Sphere> &sphere_list) { this->sphere_list = std::vector<Sphere>(sphere_list); }
-        void setCylinderList(const std::vector<Cylinder> &cylinder_list) { this->cylinder_list = std::vector<Cylinder>(cylinder_list); }
-        void setVertexList(const std::vector<Vertex> &vertex_list) { this->vertex_list = std::vector<Vertex>(vertex_list); }
-        void setVertexNormalList(const std::vector<VertexNormal> &vertex_normal_list) { this->vertex_normal_list = std::vector<VertexNormal>(vertex_normal_list); }
-        void setTextureCoordinateList(const std::vector<TextureCoordinate> &texture_coordinate_list) { this->texture_coordinate_list = std::vector<TextureCoordinate>(texture_coordinate_list); }
-        void setTriangleList(const std::vector<Triangle> &triangle_list) { this->triangle_list = std::vector<Triangle>(triangle_list); }
-        void setLightList(const std::vector<Light> &light_list) { this->light_list = std::vector<Light>(light_list); }
-        void setAttLightList(const std::vector<AttLight> &attlight_list) { this->attlight_list = std::vector<AttLight>(attlight_list); }
+        void setMaterialList(std::vector<MaterialColor> &&material_list) { this->material_list = std::move(material_list); }
+        void setTextureList(std::vector<Texture> &&texture_list) { this->texture_list = std::move(texture_list); }
+        void setBumpList(std::vector<Bump> &&bump_list) { this->bump_list = std::move(bump_list); }
+        void setSphereList(std::vector<Sphere> &&sphere_list) { this->sphere_list = std::move(sphere_list); }
+        void setCylinderList(std::vector<Cylinder> &&cylinder_list) { this->cylinder_list = std::move(cylinder_list); }
+        void setVertexList(std::vector<FloatVec3> &&vertex_list) { this->vertex_list = std::move(vertex_list); }
+        void setVertexNormalList(std::vector<FloatVec3> &&vertex_normal_list) { this->vertex_normal_list = std::move(vertex_normal_list); }
+        void setTextureCoordinateList(std::vector<FloatVec2> &&texture_coordinate_list) { this->texture_coordinate_list = std::move(texture_coordinate_list); }
+        void setTriangleVertexList(std::vector<TriangleVertices> &&triangle_vertex_list) { this->triangle_vertex_list = std::move(triangle_vertex_list); }
+        void setTriangleList(std::vector<Triangle> &&triangle_list) { this->triangle_list = std::move(triangle_list); }
+        void setLightList(std::vector<Light> &&light_list) { this->light_list = std::move(light_list); }
+        void setAttLightList(std::vector<AttLight> &&attlight_list) { this->attlight_list = std::move(attlight_list); }
         void setDepthCue(const DepthCue &depth_cue){ this->depth_cue = depth_cue; }
+        void setDepthCueEnable(bool depth_cue_enable) { this->depth_cue_enable = depth_cue_enable; }
+        void setDependencyList(std::vector<std::string> &&dependency_list) { this->dependency_list = std::move(dependency_list); }
 
         // parse the scene parameters from the input file, return the number of keywords catched
         int parseScene(std::string filename);
 
     private:
+        // append an OBJ mesh after the current geometry, faces without a usemtl material
+        // use the material, texture and normal map given
+        void importMesh(const ObjFile &mesh, int m_idx, int texture_idx, int bump_idx);
+
         FloatVec3 eye;
         FloatVec3 viewdir;
         FloatVec3 updir;
@@ -90,13 +102,13 @@ class Scene
         std::vector<Sphere> sphere_list;
         // a list of cylinders
         std::vector<Cylinder> cylinder_list;
-        // a list of vertexes
-        std::vector<Vertex> vertex_list;
-        // a list of vertex normals
-        std::vector<VertexNormal> vertex_normal_list;
-        // a list of texture coordinates
-        std::vector<TextureCoordinate> texture_coordinate_list;
-        // a list of triangles
+        // vertex positions, normals and texture coordinates, indexed from 0
+        std::vector<FloatVec3> vertex_list;
+        std::vector<FloatVec3> vertex_normal_list;
+        std::vector<FloatVec2> texture_coordinate_list;
+        // vertex indices of the triangles, read while intersecting
+        std::vector<TriangleVertices> triangle_vertex_list;
+        // shading attributes of the triangles, in the same order
         std::vector<Triangle> triangle_list;
         // a list of normal lights
         std::vector<Light> light_list;
@@ -105,6 +117,9 @@ class Scene
         // depth cueing
         DepthCue depth_cue;
         bool depth_cue_enable;
+        // the files read besides the scene file, i.e. images, meshes and material libraries,
+        // in the order they were named, recorded so the scene cache can tell when it is stale
+        std::vector<std::string> dependency_list;
 };
 
 #endif // SRC_SCENE_H_
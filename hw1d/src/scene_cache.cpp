@@ -0,0 +1,459 @@
+/**
+ * @file scene_cache.cpp
+ *
+ * @copyright 2022 Zecheng Qian, All rights reserved.
+ */
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <type_traits>
+#include <vector>
+#include <sys/stat.h>
+#include "scene_cache.h"
+#include "mapped_file.h"
+
+// first bytes of every cache file
+static const char CACHE_MAGIC[8] = {'R', 'T', 'S', 'C', 'E', 'N', 'E', '\0'};
+
+// size and modification time of a file the cache was built from
+typedef struct FileStampType
+{
+    uint64_t size;
+    // nanoseconds, whole seconds miss an edit made within the second the cache was written
+    int64_t mtime_ns;
+} FileStamp;
+
+// identity of the scene file the cache was built from, the files the scene reads
+// follow as a count and then a length prefixed path and a FileStamp each
+typedef struct CacheHeaderType
+{
+    char magic[8];
+    uint32_t version;
+    // size of the types that are stored raw, guards against a different build
+    uint32_t pod_size;
+    FileStamp source;
+} CacheHeader;
+
+// sum of the sizes of the types stored as raw bytes
+static uint32_t pod_size()
+{
+    return sizeof(FloatVec3) + sizeof(Color) + sizeof(MaterialColor) + sizeof(Sphere) + sizeof(Cylinder) +
+           sizeof(FloatVec2) + sizeof(TriangleVertices) + sizeof(Triangle) +
+           sizeof(Light) + sizeof(AttLight) + sizeof(DepthCue) + sizeof(Procedural) +
+           sizeof(Rgba8) + sizeof(OctNormal);
+}
+
+// the current stamp of a file, a missing file gets a size no real file has,
+// so a cache built while a texture was missing is rebuilt once it appears
+static FileStamp file_stamp(const std::string &filename)
+{
+    FileStamp stamp;
+    struct stat st;
+    if (stat(filename.c_str(), &st) != 0)
+    {
+        stamp.size = UINT64_MAX;
+        stamp.mtime_ns = 0;
+        return stamp;
+    }
+    stamp.size = st.st_size;
+    stamp.mtime_ns = int64_t(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+    return stamp;
+}
+
+static bool same_stamp(const FileStamp &a, const FileStamp &b)
+{
+    return a.size == b.size && a.mtime_ns == b.mtime_ns;
+}
+
+// fill in the header for the current source file
+static bool source_header(const std::string &source, CacheHeader &header)
+{
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    header.version = SCENE_CACHE_VERSION;
+    header.pod_size = pod_size();
+    header.source = file_stamp(source);
+    return header.source.size != UINT64_MAX;
+}
+
+// appends raw values to a byte buffer
+class CacheWriter
+{
+    public:
+        template <typename T>
+        void write(const T &value)
+        {
+            static_assert(std::is_trivially_copyable<T>::value, "only trivially copyable types are cached raw");
+            this->writeBytes(&value, sizeof(T));
+        }
+
+        template <typename T>
+        void writeVector(const std::vector<T> &values)
+        {
+            static_assert(std::is_trivially_copyable<T>::value, "only trivially copyable types are cached raw");
+            this->write(uint64_t(values.size()));
+            this->writeBytes(values.data(), values.size() * sizeof(T));
+        }
+
+        void writeString(const std::string &value)
+        {
+            this->write(uint64_t(value.size()));
+            this->writeBytes(value.data(), value.size());
+        }
+
+        template <typename T>
+        void writeImage(const TiledImage<T> &image)
+        {
+            this->write(int32_t(image.getWidth()));
+            this->write(int32_t(image.getHeight()));
+            this->writeBytes(image.data(), image.capacity() * sizeof(T));
+        }
+
+        void writeBytes(const void *data, size_t size)
+        {
+            const char *bytes = static_cast<const char *>(data);
+            this->buffer.insert(this->buffer.end(), bytes, bytes + size);
+        }
+
+        const std::vector<char> &getBuffer() const { return this->buffer; }
+
+    private:
+        std::vector<char> buffer;
+};
+
+// reads raw values back from a mapped cache file, every read is bounds checked
+class CacheReader
+{
+    public:
+        CacheReader(const char *begin, const char *end)
+            : cur(begin), last(end)
+        {
+        }
+
+        template <typename T>
+        bool read(T &value)
+        {
+            return this->readBytes(&value, sizeof(T));
+        }
+
+        template <typename T>
+        bool readVector(std::vector<T> &values)
+        {
+            uint64_t count;
+            if (!this->read(count) || count > size_t(this->last - this->cur) / sizeof(T))
+            {
+                return false;
+            }
+            values.clear();
+            if (count == 0)
+            {
+                return true;
+            }
+            // some of the cached types have no default constructor, so size the vector with
+            // copies of the first element and then copy the whole array over it at once
+            typename std::aligned_storage<sizeof(T), alignof(T)>::type slot;
+            memcpy(&slot, this->cur, sizeof(T));
+            values.assign(count, *reinterpret_cast<const T *>(&slot));
+            this->readBytes(values.data(), count * sizeof(T));
+            return true;
+        }
+
+        bool readString(std::string &value)
+        {
+            uint64_t size;
+            if (!this->read(size) || size > size_t(this->last - this->cur))
+            {
+                return false;
+            }
+            value.assign(this->cur, size);
+            this->cur += size;
+            return true;
+        }
+
+        template <typename T>
+        bool readImage(TiledImage<T> &image)
+        {
+            int32_t width, height;
+            if (!this->read(width) || !this->read(height) || width < 0 || height < 0 ||
+                size_t(width) * height > size_t(this->last - this->cur) / sizeof(T))
+            {
+                return false;
+            }
+            image.resize(width, height);
+            return this->readBytes(image.data(), image.capacity() * sizeof(T));
+        }
+
+        bool readBytes(void *data, size_t size)
+        {
+            if (size > size_t(this->last - this->cur))
+            {
+                return false;
+            }
+            memcpy(data, this->cur, size);
+            this->cur += size;
+            return true;
+        }
+
+    private:
+        const char *cur;
+        const char *last;
+};
+
+std::string scene_cache_filename(const std::string &filename)
+{
+    return filename + ".cache";
+}
+
+bool save_scene_cache(const Scene &scene, int num_keywords, const std::string &source, const std::string &cache)
+{
+    CacheHeader header;
+    if (!source_header(source, header))
+    {
+        return false;
+    }
+    CacheWriter writer;
+    writer.write(header);
+    // the files the scene read, each with its stamp at the time the cache is written
+    const std::vector<std::string> &dependency_list = scene.getDependencyList();
+    writer.write(uint64_t(dependency_list.size()));
+    for (size_t k = 0; k < dependency_list.size(); k++)
+    {
+        writer.writeString(dependency_list[k]);
+        writer.write(file_stamp(dependency_list[k]));
+    }
+    writer.write(int32_t(num_keywords));
+    // camera and image
+    writer.write(scene.getEye());
+    writer.write(scene.getViewdir());
+    writer.write(scene.getUpdir());
+    writer.write(scene.getBkgcolor());
+    writer.write(scene.getVfov());
+    writer.write(int32_t(scene.getWidth()));
+    writer.write(int32_t(scene.getHeight()));
+    writer.write(scene.getDepthCue());
+    writer.write(uint8_t(scene.depthCueEnable()));
+    // lights and objects
+    writer.writeVector(scene.getMaterialList());
+    writer.writeVector(scene.getSphereList());
+    writer.writeVector(scene.getCylinderList());
+    writer.writeVector(scene.getVertexList());
+    writer.writeVector(scene.getVertexNormalList());
+    writer.writeVector(scene.getTextureCoordinateList());
+    writer.writeVector(scene.getTriangleVertexList());
+    writer.writeVector(scene.getTriangleList());
+    writer.writeVector(scene.getLightList());
+    writer.writeVector(scene.getAttLightList());
+    // decoded textures with all their mipmap levels
+    const std::vector<Texture> &texture_list = scene.getTextureList();
+    writer.write(uint64_t(texture_list.size()));
+    for (size_t k = 0; k < texture_list.size(); k++)
+    {
+        const Texture &texture = texture_list[k];
+        writer.write(uint8_t(texture.proceduralEnable()));
+        writer.write(int32_t(texture.getMaxVal()));
+        if (texture.proceduralEnable())
+        {
+            writer.write(texture.getProcedural());
+            continue;
+        }
+        writer.write(int32_t(texture.getLevels()));
+        for (int level = 0; level < texture.getLevels(); level++)
+        {
+            writer.writeImage(texture.getLevel(level));
+        }
+    }
+    const std::vector<Bump> &bump_list = scene.getBumpList();
+    writer.write(uint64_t(bump_list.size()));
+    for (size_t k = 0; k < bump_list.size(); k++)
+    {
+        const Bump &bump = bump_list[k];
+        writer.write(int32_t(bump.getMaxVal()));
+        writer.write(int32_t(bump.getLevels()));
+        for (int level = 0; level < bump.getLevels(); level++)
+        {
+            writer.writeImage(bump.getLevel(level));
+        }
+    }
+
+    // write to a temporary file first, so that a partial cache is never picked up
+    std::string temp = cache + ".tmp";
+    std::ofstream outputstream(temp, std::ios::out | std::ios::binary);
+    if (!outputstream.is_open())
+    {
+        return false;
+    }
+    outputstream.write(writer.getBuffer().data(), writer.getBuffer().size());
+    outputstream.close();
+    if (!outputstream || rename(temp.c_str(), cache.c_str()) != 0)
+    {
+        remove(temp.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool load_scene_cache(Scene &scene, int &num_keywords, const std::string &source, const std::string &cache)
+{
+    CacheHeader expected, header;
+    if (!source_header(source, expected))
+    {
+        return false;
+    }
+    MappedFile file(cache);
+    if (!file.isOpen())
+    {
+        return false;
+    }
+    CacheReader reader(file.begin(), file.end());
+    if (!reader.read(header) || memcmp(&header, &expected, sizeof(header)) != 0)
+    {
+        // stale cache or a different format
+        return false;
+    }
+    uint64_t num_dependencies;
+    if (!reader.read(num_dependencies))
+    {
+        return false;
+    }
+    std::vector<std::string> dependency_list;
+    for (uint64_t k = 0; k < num_dependencies; k++)
+    {
+        std::string dependency;
+        FileStamp stamp;
+        if (!reader.readString(dependency) || !reader.read(stamp) ||
+            !same_stamp(stamp, file_stamp(dependency)))
+        {
+            // an image, mesh or material library changed since the cache was written
+            return false;
+        }
+        dependency_list.push_back(dependency);
+    }
+
+    // read everything into local lists, and only commit them to the scene once complete
+    int32_t keywords, width, height;
+    FloatVec3 eye, viewdir, updir;
+    Color bkgcolor;
+    float vfov;
+    DepthCue depth_cue;
+    uint8_t depth_cue_enable;
+    std::vector<MaterialColor> material_list;
+    std::vector<Sphere> sphere_list;
+    std::vector<Cylinder> cylinder_list;
+    std::vector<FloatVec3> vertex_list;
+    std::vector<FloatVec3> vertex_normal_list;
+    std::vector<FloatVec2> texture_coordinate_list;
+    std::vector<TriangleVertices> triangle_vertex_list;
+    std::vector<Triangle> triangle_list;
+    std::vector<Light> light_list;
+    std::vector<AttLight> attlight_list;
+    bool ok = reader.read(keywords) &&
+              reader.read(eye) && reader.read(viewdir) && reader.read(updir) &&
+              reader.read(bkgcolor) && reader.read(vfov) &&
+              reader.read(width) && reader.read(height) &&
+              reader.read(depth_cue) && reader.read(depth_cue_enable) &&
+              reader.readVector(material_list) &&
+              reader.readVector(sphere_list) &&
+              reader.readVector(cylinder_list) &&
+              reader.readVector(vertex_list) &&
+              reader.readVector(vertex_normal_list) &&
+              reader.readVector(texture_coordinate_list) &&
+              reader.readVector(triangle_vertex_list) &&
+              reader.readVector(triangle_list) &&
+              reader.readVector(light_list) &&
+              reader.readVector(attlight_list);
+    if (!ok)
+    {
+        return false;
+    }
+    uint64_t num_textures;
+    if (!reader.read(num_textures))
+    {
+        return false;
+    }
+    std::vector<Texture> texture_list;
+    for (uint64_t k = 0; k < num_textures; k++)
+    {
+        uint8_t procedural_enable;
+        int32_t max_val, levels;
+        if (!reader.read(procedural_enable) || !reader.read(max_val))
+        {
+            return false;
+        }
+        if (procedural_enable)
+        {
+            Procedural procedural;
+            if (!reader.read(procedural))
+            {
+                return false;
+            }
+            texture_list.push_back(Texture(procedural));
+            continue;
+        }
+        Texture texture(0, 0, max_val);
+        if (!reader.read(levels))
+        {
+            return false;
+        }
+        for (int level = 0; level < levels; level++)
+        {
+            TiledImage<Rgba8> image;
+            if (!reader.readImage(image))
+            {
+                return false;
+            }
+            texture.appendLevel(std::move(image));
+        }
+        texture_list.push_back(std::move(texture));
+    }
+    uint64_t num_bumps;
+    if (!reader.read(num_bumps))
+    {
+        return false;
+    }
+    std::vector<Bump> bump_list;
+    for (uint64_t k = 0; k < num_bumps; k++)
+    {
+        int32_t max_val, levels;
+        if (!reader.read(max_val) || !reader.read(levels))
+        {
+            return false;
+        }
+        Bump bump(0, 0, max_val);
+        for (int level = 0; level < levels; level++)
+        {
+            TiledImage<OctNormal> image;
+            if (!reader.readImage(image))
+            {
+                return false;
+            }
+            bump.appendLevel(std::move(image));
+        }
+        bump_list.push_back(std::move(bump));
+    }
+
+    scene.setEye(eye);
+    scene.setViewdir(viewdir);
+    scene.setUpdir(updir);
+    scene.setBkgcolor(bkgcolor);
+    scene.setVfov(vfov);
+    scene.setWidth(width);
+    scene.setHeight(height);
+    scene.setDepthCue(depth_cue);
+    scene.setDepthCueEnable(depth_cue_enable != 0);
+    scene.setMaterialList(std::move(material_list));
+    scene.setTextureList(std::move(texture_list));
+    scene.setBumpList(std::move(bump_list));
+    scene.setSphereList(std::move(sphere_list));
+    scene.setCylinderList(std::move(cylinder_list));
+    scene.setVertexList(std::move(vertex_list));
+    scene.setVertexNormalList(std::move(vertex_normal_list));
+    scene.setTextureCoordinateList(std::move(texture_coordinate_list));
+    scene.setTriangleVertexList(std::move(triangle_vertex_list));
+    scene.setTriangleList(std::move(triangle_list));
+    scene.setLightList(std::move(light_list));
+    scene.setAttLightList(std::move(attlight_list));
+    scene.setDependencyList(std::move(dependency_list));
+    num_keywords = keywords;
+    return true;
+}
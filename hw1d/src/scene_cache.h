@@ -0,0 +1,29 @@
+/**
+ * @file scene_cache.h
+ *
+ * @copyright 2022 Zecheng Qian, All rights reserved.
+ */
+#ifndef SRC_SCENE_CACHE_H_
+#define SRC_SCENE_CACHE_H_
+
+#include <string>
+#include "scene.h"
+
+// version of the binary scene cache format, bump it whenever a cached type changes layout
+#define SCENE_CACHE_VERSION 3
+
+// name of the cache file of a scene description file
+std::string scene_cache_filename(const std::string &filename);
+
+// write the parsed scene, including decoded textures and normal maps, to a binary cache
+// source is the scene description file, its size and modification time are recorded,
+// and so are those of every file in the dependency list of the scene
+// return false if the cache could not be written
+bool save_scene_cache(const Scene &scene, int num_keywords, const std::string &source, const std::string &cache);
+
+// load a scene from a binary cache written by save_scene_cache
+// return false, leaving the scene untouched, if the cache is missing, stale or corrupted,
+// stale meaning the scene file or any file it read has a different size or modification time
+bool load_scene_cache(Scene &scene, int &num_keywords, const std::string &source, const std::string &cache);
+
+#endif // SRC_SCENE_CACHE_H_
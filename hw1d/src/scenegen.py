@@ -0,0 +1,294 @@
+#!/usr/bin/env python3
+"""Generate hw1d scene files of a chosen size for scalability sweeps.
+
+    python3 scenegen.py --spheres 1000 --triangles 20000 --lights 4 \\
+        --transparent 0.2 --textured 0.3 -o big.txt
+
+Spheres are scattered over a box above a height field terrain, and the
+triangles are split between the terrain and tessellated spheres. The same
+seed always gives the same scene.
+"""
+import argparse
+import math
+import random
+import sys
+
+# extent of the box the objects are scattered in, the terrain spans x and z
+HALF_WIDTH = 10.0
+HEIGHT = 6.0
+PROC_TEXTURES = ('checker', 'stripes', 'gradient', 'noise', 'fbm')
+
+
+class SceneWriter(object):
+    """Accumulates scene lines and keeps the inline v/vt/vn numbering."""
+
+    def __init__(self):
+        self.lines = []
+        self.num_v = 0
+        self.num_vt = 0
+        self.num_vn = 0
+        self.num_spheres = 0
+        self.num_triangles = 0
+
+    def add(self, line):
+        self.lines.append(line)
+
+    def vertex(self, p, n, uv):
+        # every mesh vertex gets a normal and a texture coordinate, so returns one index for all three
+        self.add('v %.5f %.5f %.5f' % p)
+        self.add('vn %.5f %.5f %.5f' % n)
+        self.add('vt %.5f %.5f' % uv)
+        self.num_v += 1
+        self.num_vt += 1
+        self.num_vn += 1
+        return self.num_v
+
+    def face(self, a, b, c, textured):
+        # faces without texture coordinates are never textured
+        if textured:
+            self.add('f %d/%d/%d %d/%d/%d %d/%d/%d' % (a, a, a, b, b, b, c, c, c))
+        else:
+            self.add('f %d//%d %d//%d %d//%d' % (a, a, b, b, c, c))
+        self.num_triangles += 1
+
+    def text(self):
+        return '\n'.join(self.lines) + '\n'
+
+
+def material(rng, transparent):
+    """A random mtlcolor line, Od Os ka kd ks n alpha eta."""
+    od = [rng.uniform(0.1, 1.0) for _ in range(3)]
+    if transparent:
+        alpha, eta = rng.uniform(0.2, 0.6), rng.uniform(1.1, 1.6)
+    else:
+        alpha, eta = 1.0, 1.0
+    return 'mtlcolor %.3f %.3f %.3f 1 1 1 0.1 %.3f %.3f %d %.3f %.3f' % (
+        od[0], od[1], od[2], rng.uniform(0.4, 0.8), rng.uniform(0.1, 0.5),
+        rng.choice((10, 20, 50, 100)), alpha, eta)
+
+
+def texture(rng, image):
+    """A texture line, the given image or else a random procedural pattern."""
+    if image:
+        return 'texture %s' % image
+    return 'proctexture %s %d %d %.3f %.3f %.3f %.3f %.3f %.3f' % (
+        rng.choice(PROC_TEXTURES), rng.randint(2, 16), rng.randint(2, 16),
+        rng.random(), rng.random(), rng.random(), rng.random(), rng.random(), rng.random())
+
+
+def terrain_height(x, z):
+    return -1.0 + 0.6 * math.sin(0.45 * x) * math.cos(0.35 * z) + 0.25 * math.sin(1.3 * x + 0.7 * z)
+
+
+def add_terrain(out, rng, triangles, args):
+    """A grid of about the given number of triangles, returns how many were written."""
+    cells = max(1, triangles // 2)
+    nx = max(1, int(math.sqrt(cells)))
+    nz = max(1, cells // nx)
+    out.add('# terrain, %dx%d cells' % (nx, nz))
+    textured = rng.random() < args.textured
+    out.add(material(rng, False))
+    if textured:
+        out.add(texture(rng, args.texture))
+    index = []
+    eps = 1e-3
+    for j in range(nz + 1):
+        for i in range(nx + 1):
+            x = -HALF_WIDTH * 2 + 4 * HALF_WIDTH * i / nx
+            z = -HALF_WIDTH * 2 + 4 * HALF_WIDTH * j / nz
+            y = terrain_height(x, z)
+            # the normal from central differences of the height field
+            dx = (terrain_height(x + eps, z) - terrain_height(x - eps, z)) / (2 * eps)
+            dz = (terrain_height(x, z + eps) - terrain_height(x, z - eps)) / (2 * eps)
+            length = math.sqrt(dx * dx + 1 + dz * dz)
+            index.append(out.vertex((x, y, z), (-dx / length, 1 / length, -dz / length),
+                                    (float(i) / nx, float(j) / nz)))
+    for j in range(nz):
+        for i in range(nx):
+            a = index[j * (nx + 1) + i]
+            b = a + 1
+            c = index[(j + 1) * (nx + 1) + i]
+            d = c + 1
+            # counter-clockwise seen from above
+            out.face(a, c, b, textured)
+            out.face(b, c, d, textured)
+    return 2 * nx * nz
+
+
+def add_mesh_sphere(out, center, radius, slices, textured):
+    """A uv sphere of 2 * slices * (slices / 2 - 1) triangles."""
+    stacks = max(2, slices // 2)
+    index = []
+    for j in range(stacks + 1):
+        theta = math.pi * j / stacks
+        for i in range(slices + 1):
+            phi = 2 * math.pi * i / slices
+            n = (math.sin(theta) * math.cos(phi), math.cos(theta), math.sin(theta) * math.sin(phi))
+            p = tuple(c + radius * k for c, k in zip(center, n))
+            index.append(out.vertex(p, n, (float(i) / slices, float(j) / stacks)))
+    for j in range(stacks):
+        for i in range(slices):
+            a = index[j * (slices + 1) + i]
+            b = a + 1
+            c = index[(j + 1) * (slices + 1) + i]
+            d = c + 1
+            # the triangles at the poles would be degenerate
+            if j != 0:
+                out.face(a, b, c, textured)
+            if j != stacks - 1:
+                out.face(b, d, c, textured)
+
+
+class Placer(object):
+    """Scatters spheres over the box without overlaps.
+
+    The renderer tracks whether a ray is inside a transparent object with a single flag,
+    so transparent objects must not intersect anything else.
+    """
+
+    def __init__(self, rng, cell):
+        self.rng = rng
+        self.cell = cell
+        self.grid = {}
+
+    def key(self, p):
+        return tuple(int(math.floor(c / self.cell)) for c in p)
+
+    def free(self, p, radius):
+        # the cells are as wide as two of the largest radii, so only the neighbors can overlap
+        kx, ky, kz = self.key(p)
+        for x in range(kx - 1, kx + 2):
+            for y in range(ky - 1, ky + 2):
+                for z in range(kz - 1, kz + 2):
+                    for q, r in self.grid.get((x, y, z), ()):
+                        if sum((a - b) ** 2 for a, b in zip(p, q)) < (radius + r) ** 2:
+                            return False
+        return True
+
+    def place(self, radius):
+        """A center for a sphere of about the given radius, returns (center, radius)."""
+        while True:
+            for _ in range(50):
+                # above the highest point of the terrain
+                p = (self.rng.uniform(-HALF_WIDTH + radius, HALF_WIDTH - radius),
+                     self.rng.uniform(radius, max(radius, HEIGHT - radius)),
+                     self.rng.uniform(-HALF_WIDTH + radius, HALF_WIDTH - radius))
+                if self.free(p, radius):
+                    self.grid.setdefault(self.key(p), []).append((p, radius))
+                    return p, radius
+            # the box is crowded, try a smaller object
+            radius *= 0.8
+
+
+def generate(args):
+    """Build the scene described by the parsed command line options, returns its SceneWriter."""
+    rng = random.Random(args.seed)
+    out = SceneWriter()
+    width, height = args.imsize
+    out.add('# generated by scenegen.py --seed %d --spheres %d --triangles %d --lights %d '
+            '--transparent %g --textured %g' % (args.seed, args.spheres, args.triangles, args.lights,
+                                                args.transparent, args.textured))
+    out.add('eye 0 9 24')
+    out.add('viewdir 0 -0.4 -1')
+    out.add('updir 0 1 0')
+    out.add('vfov 50')
+    out.add('imsize %d %d' % (width, height))
+    out.add('bkgcolor 0.2 0.25 0.35')
+
+    # half of the lights are point lights above the scene, the rest directional
+    for k in range(args.lights):
+        color = min(1.0, 1.5 / args.lights)
+        if k % 2 == 0:
+            p = (rng.uniform(-HALF_WIDTH, HALF_WIDTH), rng.uniform(HEIGHT + 2, HEIGHT + 8),
+                 rng.uniform(-HALF_WIDTH, HALF_WIDTH))
+            out.add('light %.3f %.3f %.3f 1 %.3f %.3f %.3f' % (p + (color, color, color)))
+        else:
+            out.add('light %.3f %.3f %.3f 0 %.3f %.3f %.3f' % (
+                rng.uniform(-1, 1), -1, rng.uniform(-1, 1), color, color, color))
+
+    # a texture stays on for every sphere that follows it, so untextured spheres go first
+    # the radius shrinks as the count grows, keeping the box from filling up
+    scale = min(1.0, (200.0 / max(1, args.spheres)) ** (1.0 / 3))
+    placer = Placer(rng, 2.4 * scale)
+    first_textured = args.spheres - int(round(args.spheres * args.textured))
+    for k in range(args.spheres):
+        # a new texture every 16 spheres
+        if k >= first_textured and (k - first_textured) % 16 == 0:
+            out.add(texture(rng, args.texture))
+        center, radius = placer.place(rng.uniform(0.3, 0.9) * scale)
+        out.add(material(rng, rng.random() < args.transparent))
+        out.add('sphere %.4f %.4f %.4f %.4f' % (center + (radius,)))
+        out.num_spheres += 1
+
+    # triangles are textured by giving their faces texture coordinates
+    terrain = int(args.triangles * args.terrain) if args.triangles else 0
+    if terrain:
+        add_terrain(out, rng, terrain, args)
+    remaining = args.triangles - out.num_triangles
+    while remaining > 0:
+        # meshes of up to mesh_triangles each, the last one smaller
+        budget = min(remaining, args.mesh_triangles)
+        slices = 4
+        while 2 * (slices + 2) * ((slices + 2) // 2 - 1) <= budget:
+            slices += 2
+        before = out.num_triangles
+        center, radius = placer.place(rng.uniform(0.4, 1.2) * scale)
+        textured = rng.random() < args.textured
+        out.add(material(rng, rng.random() < args.transparent))
+        if textured:
+            out.add(texture(rng, args.texture))
+        add_mesh_sphere(out, center, radius, slices, textured)
+        remaining -= max(1, out.num_triangles - before)
+    return out
+
+
+def parse_imsize(text):
+    try:
+        width, height = (int(v) for v in text.lower().split('x'))
+    except ValueError:
+        raise argparse.ArgumentTypeError('expected WIDTHxHEIGHT, got %s' % text)
+    return width, height
+
+
+def fraction(text):
+    value = float(text)
+    if not 0 <= value <= 1:
+        raise argparse.ArgumentTypeError('expected a fraction in [0, 1], got %s' % text)
+    return value
+
+
+def add_options(parser):
+    """Scene options, shared with sweep.py."""
+    parser.add_argument('--spheres', type=int, default=100, help='number of spheres')
+    parser.add_argument('--triangles', type=int, default=0, help='approximate number of triangles')
+    parser.add_argument('--lights', type=int, default=2, help='number of lights')
+    parser.add_argument('--transparent', type=fraction, default=0.0,
+                        help='fraction of objects with opacity below 1')
+    parser.add_argument('--textured', type=fraction, default=0.0, help='fraction of textured objects')
+    parser.add_argument('--terrain', type=fraction, default=0.5,
+                        help='fraction of the triangles in the terrain, the rest are tessellated spheres')
+    parser.add_argument('--mesh-triangles', type=int, default=512,
+                        help='triangles per tessellated sphere')
+    parser.add_argument('--texture', help='texture image to use instead of procedural textures')
+    parser.add_argument('--imsize', type=parse_imsize, default=(256, 256), help='WIDTHxHEIGHT')
+    parser.add_argument('--seed', type=int, default=2022)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split('\n')[0])
+    add_options(parser)
+    parser.add_argument('-o', '--output', help='scene file to write, stdout by default')
+    args = parser.parse_args()
+    scene = generate(args)
+    if args.output:
+        with open(args.output, 'w') as f:
+            f.write(scene.text())
+    else:
+        sys.stdout.write(scene.text())
+    sys.stderr.write('%d spheres, %d triangles, %d lights\n' % (scene.num_spheres, scene.num_triangles,
+                                                                args.lights))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
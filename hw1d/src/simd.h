@@ -0,0 +1,349 @@
+/**
+ * @file simd.h
+ *
+ * @copyright 2022 Zecheng Qian, All rights reserved.
+ */
+#ifndef SRC_SIMD_H_
+#define SRC_SIMD_H_
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+// pick the instruction set of the 4-lane vector, SSE on x86-64, NEON on ARM,
+// and plain floats everywhere else
+#if defined(__SSE2__) || defined(_M_X64)
+#define SIMD_SSE
+#include <immintrin.h>
+#elif defined(__ARM_NEON)
+#define SIMD_NEON
+#include <arm_neon.h>
+#else
+#define SIMD_SCALAR
+#endif
+
+// a 4-lane float vector held in one SIMD register, used for 3d points, directions and colors
+// the last lane is padding for those, and is kept to 0 by the 3d constructors
+struct alignas(16) Vec4f
+{
+#if defined(SIMD_SSE)
+    __m128 v;
+    explicit Vec4f(__m128 v_) : v(v_) {}
+#elif defined(SIMD_NEON)
+    float32x4_t v;
+    explicit Vec4f(float32x4_t v_) : v(v_) {}
+#else
+    float v[4];
+#endif
+
+    // default constructor, all lanes 0
+    Vec4f() { *this = Vec4f(0, 0, 0, 0); }
+
+    // constructor from the lanes
+    Vec4f(float x, float y, float z, float w = 0)
+    {
+#if defined(SIMD_SSE)
+        this->v = _mm_setr_ps(x, y, z, w);
+#elif defined(SIMD_NEON)
+        float lanes[4] = {x, y, z, w};
+        this->v = vld1q_f32(lanes);
+#else
+        this->v[0] = x;
+        this->v[1] = y;
+        this->v[2] = z;
+        this->v[3] = w;
+#endif
+    }
+
+    // the same value in all lanes
+    static Vec4f splat(float c)
+    {
+#if defined(SIMD_SSE)
+        return Vec4f(_mm_set1_ps(c));
+#elif defined(SIMD_NEON)
+        return Vec4f(vdupq_n_f32(c));
+#else
+        return Vec4f(c, c, c, c);
+#endif
+    }
+
+    // getter
+    float x() const { return this->lane<0>(); }
+    float y() const { return this->lane<1>(); }
+    float z() const { return this->lane<2>(); }
+    float w() const { return this->lane<3>(); }
+
+    template <int k>
+    float lane() const
+    {
+#if defined(SIMD_SSE)
+        return _mm_cvtss_f32(_mm_shuffle_ps(this->v, this->v, _MM_SHUFFLE(k, k, k, k)));
+#elif defined(SIMD_NEON)
+        return vgetq_lane_f32(this->v, k);
+#else
+        return this->v[k];
+#endif
+    }
+
+    // lane-wise arithmetic
+    Vec4f operator+(const Vec4f &a) const
+    {
+#if defined(SIMD_SSE)
+        return Vec4f(_mm_add_ps(this->v, a.v));
+#elif defined(SIMD_NEON)
+        return Vec4f(vaddq_f32(this->v, a.v));
+#else
+        return Vec4f(this->v[0] + a.v[0], this->v[1] + a.v[1], this->v[2] + a.v[2], this->v[3] + a.v[3]);
+#endif
+    }
+
+    Vec4f operator-(const Vec4f &a) const
+    {
+#if defined(SIMD_SSE)
+        return Vec4f(_mm_sub_ps(this->v, a.v));
+#elif defined(SIMD_NEON)
+        return Vec4f(vsubq_f32(this->v, a.v));
+#else
+        return Vec4f(this->v[0] - a.v[0], this->v[1] - a.v[1], this->v[2] - a.v[2], this->v[3] - a.v[3]);
+#endif
+    }
+
+    Vec4f operator*(const Vec4f &a) const
+    {
+#if defined(SIMD_SSE)
+        return Vec4f(_mm_mul_ps(this->v, a.v));
+#elif defined(SIMD_NEON)
+        return Vec4f(vmulq_f32(this->v, a.v));
+#else
+        return Vec4f(this->v[0] * a.v[0], this->v[1] * a.v[1], this->v[2] * a.v[2], this->v[3] * a.v[3]);
+#endif
+    }
+
+    Vec4f operator/(const Vec4f &a) const
+    {
+#if defined(SIMD_SSE)
+        return Vec4f(_mm_div_ps(this->v, a.v));
+#elif defined(SIMD_NEON) && defined(__aarch64__)
+        return Vec4f(vdivq_f32(this->v, a.v));
+#else
+        return Vec4f(this->x() / a.x(), this->y() / a.y(), this->z() / a.z(), this->w() / a.w());
+#endif
+    }
+
+    Vec4f operator*(float c) const { return *this * Vec4f::splat(c); }
+    Vec4f operator/(float c) const { return *this / Vec4f::splat(c); }
+    Vec4f operator-() const { return Vec4f() - *this; }
+    Vec4f &operator+=(const Vec4f &a) { return *this = *this + a; }
+};
+
+// lane-wise minimum and maximum
+inline Vec4f min(const Vec4f &a, const Vec4f &b)
+{
+#if defined(SIMD_SSE)
+    return Vec4f(_mm_min_ps(a.v, b.v));
+#elif defined(SIMD_NEON)
+    return Vec4f(vminq_f32(a.v, b.v));
+#else
+    return Vec4f(std::fmin(a.v[0], b.v[0]), std::fmin(a.v[1], b.v[1]), std::fmin(a.v[2], b.v[2]), std::fmin(a.v[3], b.v[3]));
+#endif
+}
+
+inline Vec4f max(const Vec4f &a, const Vec4f &b)
+{
+#if defined(SIMD_SSE)
+    return Vec4f(_mm_max_ps(a.v, b.v));
+#elif defined(SIMD_NEON)
+    return Vec4f(vmaxq_f32(a.v, b.v));
+#else
+    return Vec4f(std::fmax(a.v[0], b.v[0]), std::fmax(a.v[1], b.v[1]), std::fmax(a.v[2], b.v[2]), std::fmax(a.v[3], b.v[3]));
+#endif
+}
+
+// lane-wise square root
+inline Vec4f sqrt(const Vec4f &a)
+{
+#if defined(SIMD_SSE)
+    return Vec4f(_mm_sqrt_ps(a.v));
+#elif defined(SIMD_NEON) && defined(__aarch64__)
+    return Vec4f(vsqrtq_f32(a.v));
+#else
+    return Vec4f(std::sqrt(a.x()), std::sqrt(a.y()), std::sqrt(a.z()), std::sqrt(a.w()));
+#endif
+}
+
+// lane-wise absolute value
+inline Vec4f abs(const Vec4f &a)
+{
+#if defined(SIMD_SSE)
+    return Vec4f(_mm_andnot_ps(_mm_set1_ps(-0.0f), a.v));
+#elif defined(SIMD_NEON)
+    return Vec4f(vabsq_f32(a.v));
+#else
+    return Vec4f(std::fabs(a.v[0]), std::fabs(a.v[1]), std::fabs(a.v[2]), std::fabs(a.v[3]));
+#endif
+}
+
+// round towards zero to a whole number, for lanes within the int range
+inline Vec4f trunc(const Vec4f &a)
+{
+#if defined(SIMD_SSE)
+    return Vec4f(_mm_cvtepi32_ps(_mm_cvttps_epi32(a.v)));
+#elif defined(SIMD_NEON)
+    return Vec4f(vcvtq_f32_s32(vcvtq_s32_f32(a.v)));
+#else
+    return Vec4f(float(int(a.v[0])), float(int(a.v[1])), float(int(a.v[2])), float(int(a.v[3])));
+#endif
+}
+
+// lane mask of a < b, all bits set in the lanes where it holds and clear elsewhere
+inline Vec4f less(const Vec4f &a, const Vec4f &b)
+{
+#if defined(SIMD_SSE)
+    return Vec4f(_mm_cmplt_ps(a.v, b.v));
+#elif defined(SIMD_NEON)
+    return Vec4f(vreinterpretq_f32_u32(vcltq_f32(a.v, b.v)));
+#else
+    Vec4f mask;
+    for (int k = 0; k < 4; k++)
+    {
+        uint32_t bits = a.v[k] < b.v[k] ? 0xffffffffu : 0;
+        memcpy(&mask.v[k], &bits, sizeof(bits));
+    }
+    return mask;
+#endif
+}
+
+// a in the lanes where mask is set, b elsewhere
+inline Vec4f select(const Vec4f &mask, const Vec4f &a, const Vec4f &b)
+{
+#if defined(SIMD_SSE)
+    return Vec4f(_mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v)));
+#elif defined(SIMD_NEON)
+    return Vec4f(vbslq_f32(vreinterpretq_u32_f32(mask.v), a.v, b.v));
+#else
+    Vec4f r;
+    for (int k = 0; k < 4; k++)
+    {
+        uint32_t m, x, y;
+        memcpy(&m, &mask.v[k], sizeof(m));
+        memcpy(&x, &a.v[k], sizeof(x));
+        memcpy(&y, &b.v[k], sizeof(y));
+        x = (x & m) | (y & ~m);
+        memcpy(&r.v[k], &x, sizeof(x));
+    }
+    return r;
+#endif
+}
+
+// dot product of the first three lanes
+// the sum is taken as (x + y) + z, the same rounding as the scalar expression
+inline float dot3(const Vec4f &a, const Vec4f &b)
+{
+#if defined(SIMD_SSE)
+    __m128 m = _mm_mul_ps(a.v, b.v);
+    __m128 s = _mm_add_ss(m, _mm_shuffle_ps(m, m, _MM_SHUFFLE(1, 1, 1, 1)));
+    return _mm_cvtss_f32(_mm_add_ss(s, _mm_movehl_ps(m, m)));
+#else
+    Vec4f m = a * b;
+    return m.x() + m.y() + m.z();
+#endif
+}
+
+// cross product of the first three lanes, the last lane is 0
+inline Vec4f cross3(const Vec4f &a, const Vec4f &b)
+{
+#if defined(SIMD_SSE)
+    __m128 a_yzx = _mm_shuffle_ps(a.v, a.v, _MM_SHUFFLE(3, 0, 2, 1));
+    __m128 b_yzx = _mm_shuffle_ps(b.v, b.v, _MM_SHUFFLE(3, 0, 2, 1));
+    __m128 a_zxy = _mm_shuffle_ps(a.v, a.v, _MM_SHUFFLE(3, 1, 0, 2));
+    __m128 b_zxy = _mm_shuffle_ps(b.v, b.v, _MM_SHUFFLE(3, 1, 0, 2));
+    return Vec4f(_mm_sub_ps(_mm_mul_ps(a_yzx, b_zxy), _mm_mul_ps(a_zxy, b_yzx)));
+#else
+    return Vec4f(a.y() * b.z() - a.z() * b.y(),
+                 a.z() * b.x() - a.x() * b.z(),
+                 a.x() * b.y() - a.y() * b.x());
+#endif
+}
+
+// 1 / sqrt(d), from the hardware estimate refined with one Newton-Raphson step
+// the relative error is below 3e-7, against 1.5 * 2^-12 for the estimate alone
+inline float rsqrt(float d)
+{
+#if defined(SIMD_SSE)
+    float r = _mm_cvtss_f32(_mm_rsqrt_ss(_mm_set_ss(d)));
+    return r * (1.5f - 0.5f * d * r * r);
+#elif defined(SIMD_NEON)
+    float r = vget_lane_f32(vrsqrte_f32(vdup_n_f32(d)), 0);
+    // the NEON estimate has only 8 bits, so refine it once more
+    r = r * (1.5f - 0.5f * d * r * r);
+    return r * (1.5f - 0.5f * d * r * r);
+#else
+    return 1 / std::sqrt(d);
+#endif
+}
+
+// scale the first three lanes to unit length, with an exact square root and division
+// so directions that decide reflection, refraction and shadow rays round like the scalar code
+inline Vec4f normalize3(const Vec4f &a)
+{
+    return a / std::sqrt(dot3(a, a));
+}
+
+// scale the first three lanes to about unit length with rsqrt, for the batched kernels
+// whose results only feed smooth terms, where the 3e-7 relative error cannot flip a branch
+inline Vec4f normalize3_fast(const Vec4f &a)
+{
+    return a * rsqrt(dot3(a, a));
+}
+
+// linear interpolation, a at t = 0 and b at t = 1
+inline Vec4f lerp(const Vec4f &a, const Vec4f &b, float t)
+{
+    return a + (b - a) * t;
+}
+
+#if defined(__AVX__)
+// eight 3d vectors in structure of arrays layout, one 8-lane register per component
+// for processing batches of triangles or rays at once
+struct Vec3x8
+{
+    __m256 x, y, z;
+
+    // load eight vectors from separate x, y and z arrays
+    static Vec3x8 load(const float *x, const float *y, const float *z)
+    {
+        Vec3x8 r = {_mm256_loadu_ps(x), _mm256_loadu_ps(y), _mm256_loadu_ps(z)};
+        return r;
+    }
+
+    // the same vector in all eight lanes
+    static Vec3x8 splat(const Vec4f &a)
+    {
+        Vec3x8 r = {_mm256_set1_ps(a.x()), _mm256_set1_ps(a.y()), _mm256_set1_ps(a.z())};
+        return r;
+    }
+
+    Vec3x8 operator-(const Vec3x8 &a) const
+    {
+        Vec3x8 r = {_mm256_sub_ps(this->x, a.x), _mm256_sub_ps(this->y, a.y), _mm256_sub_ps(this->z, a.z)};
+        return r;
+    }
+};
+
+// eight dot products
+inline __m256 dot3(const Vec3x8 &a, const Vec3x8 &b)
+{
+    return _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(a.x, b.x), _mm256_mul_ps(a.y, b.y)), _mm256_mul_ps(a.z, b.z));
+}
+
+// eight cross products
+inline Vec3x8 cross3(const Vec3x8 &a, const Vec3x8 &b)
+{
+    Vec3x8 r = {_mm256_sub_ps(_mm256_mul_ps(a.y, b.z), _mm256_mul_ps(a.z, b.y)),
+                _mm256_sub_ps(_mm256_mul_ps(a.z, b.x), _mm256_mul_ps(a.x, b.z)),
+                _mm256_sub_ps(_mm256_mul_ps(a.x, b.y), _mm256_mul_ps(a.y, b.x))};
+    return r;
+}
+#endif
+
+#endif // SRC_SIMD_H_
@@ -4,12 +4,11 @@
  * @copyright 2022 Zecheng Qian, All rights reserved.
  */
 #include "sphere.h"
+#include "fastmath.h"
 
 FloatVec3 Sphere::normal(const FloatVec3 &p) const
 {
-    return FloatVec3((p.first - this->center.first) / this->radius,
-                     (p.second - this->center.second) / this->radius,
-                     (p.third - this->center.third) / this->radius);
+    return FloatVec3((p.simd() - this->center.simd()) / this->radius);
 }
 
 FloatVec2 Sphere::texture_coordinate(const FloatVec3 &p) const
@@ -18,8 +17,11 @@ FloatVec2 Sphere::texture_coordinate(const FloatVec3 &p) const
     float nx = n.first;
     float ny = n.second;
     float nz = n.third;
-    // add 1e-6 to avoid division by 0
-    float u = 0.5 + std::atan2(ny, nx) / (2 * PI);
-    float v = std::acos(nz) / PI;
+    // both angles from one 4-lane atan2, with acos(z) = atan2(sqrt(1 - z^2), z)
+    // 1 - z^2 is taken as (1 - z)(1 + z), which stays accurate near the poles
+    float sin_v = std::sqrt(std::max(float(0), (1 - nz) * (1 + nz)));
+    Vec4f angles = fast_atan2(Vec4f(ny, sin_v, 0), Vec4f(nx, nz, 1));
+    float u = 0.5 + angles.x() / (2 * PI);
+    float v = angles.y() / PI;
     return FloatVec2(u, v);
 }
@@ -0,0 +1,109 @@
+/**
+ * @file stats.cpp
+ *
+ * @copyright 2022 Zecheng Qian, All rights reserved.
+ */
+#include "stats.h"
+
+#ifdef RAYTRACER_STATS
+
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <mutex>
+#include <vector>
+#include "utils.h"
+
+namespace
+{
+std::mutex stats_mutex;
+// the counters of the threads that have exited
+RayStats retired_stats;
+// the counters of the threads that are still running
+std::vector<RayStats *> live_stats;
+
+void add_stats(RayStats &total, const RayStats &stats)
+{
+    for (int c = 0; c < RAY_CATEGORIES; c++)
+    {
+        total.rays[c] += stats.rays[c];
+        total.hits[c] += stats.hits[c];
+        total.sphere_tests[c] += stats.sphere_tests[c];
+        total.triangle_tests[c] += stats.triangle_tests[c];
+    }
+    total.paths += stats.paths;
+    total.path_depth += stats.path_depth;
+    total.paths_missed += stats.paths_missed;
+    total.paths_at_limit += stats.paths_at_limit;
+    total.shadow_blocked += stats.shadow_blocked;
+}
+
+// the counters of one thread, registered while the thread runs
+struct ThreadSlot
+{
+    RayStats stats;
+
+    ThreadSlot()
+    {
+        memset(&this->stats, 0, sizeof(this->stats));
+        std::lock_guard<std::mutex> lock(stats_mutex);
+        live_stats.push_back(&this->stats);
+    }
+
+    ~ThreadSlot()
+    {
+        std::lock_guard<std::mutex> lock(stats_mutex);
+        add_stats(retired_stats, this->stats);
+        live_stats.erase(std::find(live_stats.begin(), live_stats.end(), &this->stats));
+    }
+};
+
+thread_local ThreadSlot slot;
+} // namespace
+
+RayStats &thread_stats()
+{
+    return slot.stats;
+}
+
+RayStats collect_stats()
+{
+    std::lock_guard<std::mutex> lock(stats_mutex);
+    RayStats total = retired_stats;
+    for (size_t k = 0; k < live_stats.size(); k++)
+    {
+        add_stats(total, *live_stats[k]);
+    }
+    return total;
+}
+
+void print_stats(const RayStats &stats, double seconds)
+{
+    static const char *names[RAY_CATEGORIES] = {"primary", "shadow", "reflected", "transmitted", "shadow relaunch"};
+    RayStats total;
+    memset(&total, 0, sizeof(total));
+    fprintf(stderr, "%-16s %12s %12s %14s %14s\n", "rays", "cast", "hits", "sphere tests", "triangle tests");
+    for (int c = 0; c < RAY_CATEGORIES; c++)
+    {
+        fprintf(stderr, "%-16s %12llu %12llu %14llu %14llu\n", names[c],
+                (unsigned long long)stats.rays[c], (unsigned long long)stats.hits[c],
+                (unsigned long long)stats.sphere_tests[c], (unsigned long long)stats.triangle_tests[c]);
+        total.rays[0] += stats.rays[c];
+        total.hits[0] += stats.hits[c];
+        total.sphere_tests[0] += stats.sphere_tests[c];
+        total.triangle_tests[0] += stats.triangle_tests[c];
+    }
+    fprintf(stderr, "%-16s %12llu %12llu %14llu %14llu\n", "total",
+            (unsigned long long)total.rays[0], (unsigned long long)total.hits[0],
+            (unsigned long long)total.sphere_tests[0], (unsigned long long)total.triangle_tests[0]);
+    fprintf(stderr, "rays cast: %llu\n", (unsigned long long)total.rays[0]);
+    fprintf(stderr, "rays per second: %.0f in %.3f s\n", seconds > 0 ? total.rays[0] / seconds : 0.0, seconds);
+    fprintf(stderr, "average depth reached: %.3f over %llu paths\n",
+            stats.paths ? double(stats.path_depth) / stats.paths : 0.0, (unsigned long long)stats.paths);
+    fprintf(stderr, "early terminations: %llu paths left the scene before depth %d, %llu reached it, "
+                    "%llu shadow rays stopped by an opaque object\n",
+            (unsigned long long)stats.paths_missed, MAX_DEPTH, (unsigned long long)stats.paths_at_limit,
+            (unsigned long long)stats.shadow_blocked);
+}
+
+#endif // RAYTRACER_STATS
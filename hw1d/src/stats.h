@@ -0,0 +1,58 @@
+/**
+ * @file stats.h
+ *
+ * @copyright 2022 Zecheng Qian, All rights reserved.
+ */
+#ifndef SRC_STATS_H_
+#define SRC_STATS_H_
+
+#include <cstdint>
+
+// the kinds of rays that are traced, each one is counted separately
+enum RayCategory
+{
+    RAY_PRIMARY,
+    RAY_SHADOW,
+    RAY_REFLECTED,
+    RAY_TRANSMITTED,
+    RAY_SHADOW_RELAUNCH, // a shadow ray carried on through a translucent object
+    RAY_CATEGORIES
+};
+
+// counters of the rays traced by one thread
+typedef struct RayStatsType
+{
+    uint64_t rays[RAY_CATEGORIES];
+    uint64_t hits[RAY_CATEGORIES];
+    uint64_t sphere_tests[RAY_CATEGORIES];
+    uint64_t triangle_tests[RAY_CATEGORIES];
+    // paths of trace_ray_recursive, counted where they end
+    uint64_t paths;
+    uint64_t path_depth;     // sum of the depths the paths ended at
+    uint64_t paths_missed;   // ended before MAX_DEPTH because the ray left the scene
+    uint64_t paths_at_limit; // ended by MAX_DEPTH
+    uint64_t shadow_blocked; // shadow rays stopped by an opaque object
+} RayStats;
+
+// the counters are only compiled in with RAYTRACER_STATS defined, build with make STATS=1
+// otherwise STATS_ADD expands to nothing and its arguments are not evaluated
+#ifdef RAYTRACER_STATS
+
+// the counters of the calling thread, they are added to the totals when the thread exits
+RayStats &thread_stats();
+
+// the sum of the counters of all threads, running or exited
+RayStats collect_stats();
+
+// print a summary to stderr, seconds is the time spent rendering
+void print_stats(const RayStats &stats, double seconds);
+
+#define STATS_ADD(field, n) (thread_stats().field += (n))
+
+#else
+
+#define STATS_ADD(field, n) ((void)0)
+
+#endif // RAYTRACER_STATS
+
+#endif // SRC_STATS_H_
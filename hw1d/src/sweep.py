@@ -0,0 +1,153 @@
+#!/usr/bin/env python3
+"""Render generated scenes across sizes and thread counts and print scaling tables.
+
+    python3 sweep.py --sizes 250,500,1000,2000 --threads 1,2,4
+
+A size is the number of primitives in the scene, split between spheres and
+triangles by --sphere-share. The strong scaling table renders every size with
+every thread count, the weak scaling table grows the scene with the thread
+count, starting from --weak-base primitives on one thread. Scenes are made by
+scenegen.py with a fixed seed, so two builds of the raytracer can be compared
+by passing --raytracer.
+"""
+import argparse
+import json
+import os
+import shutil
+import subprocess
+import sys
+import tempfile
+import time
+
+import scenegen
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+
+
+def int_list(text):
+    return [int(v) for v in text.split(',') if v]
+
+
+class Sweep(object):
+    def __init__(self, args):
+        self.args = args
+        self.work = tempfile.mkdtemp(prefix='sweep-')
+        self.scenes = {}
+        self.times = {}
+
+    def scene(self, size):
+        """Path of the generated scene of the given size, written on first use."""
+        if size not in self.scenes:
+            options = argparse.Namespace(**vars(self.args))
+            options.spheres = int(round(size * self.args.sphere_share))
+            options.triangles = size - options.spheres
+            path = os.path.join(self.work, 'scene%d.txt' % size)
+            with open(path, 'w') as f:
+                f.write(scenegen.generate(options).text())
+            self.scenes[size] = path
+        return self.scenes[size]
+
+    def time(self, size, threads):
+        """Fastest wall time of --repeat renders of a scene."""
+        if (size, threads) not in self.times:
+            env = dict(os.environ)
+            env['RAYTRACER_THREADS'] = str(threads)
+            # the scene cache would skip parsing on every run after the first
+            env['RAYTRACER_CACHE'] = '0'
+            best = None
+            for _ in range(self.args.repeat):
+                start = time.monotonic()
+                subprocess.check_call([self.args.raytracer, os.path.basename(self.scene(size))],
+                                      cwd=self.work, env=env, stdout=subprocess.DEVNULL,
+                                      stderr=subprocess.DEVNULL)
+                seconds = time.monotonic() - start
+                best = seconds if best is None else min(best, seconds)
+            self.times[(size, threads)] = best
+            sys.stderr.write('size %d, %d threads: %.3f s\n' % (size, threads, best))
+        return self.times[(size, threads)]
+
+    def close(self):
+        shutil.rmtree(self.work, ignore_errors=True)
+
+
+def strong_scaling(sweep, sizes, threads):
+    """Fixed sizes, more threads: speedup and efficiency against the fewest threads."""
+    base = threads[0]
+    header = '| primitives | ' + ' | '.join('%d threads' % t for t in threads) + ' | best |'
+    lines = ['### Strong scaling', '',
+             'seconds (speedup, efficiency) against %d thread%s' % (base, '' if base == 1 else 's'), '',
+             header, '|' + ' --- |' * (len(threads) + 2)]
+    rows = []
+    for size in sizes:
+        t0 = sweep.time(size, base)
+        cells = []
+        best = base
+        for t in threads:
+            seconds = sweep.time(size, t)
+            speedup = t0 / seconds
+            efficiency = speedup * base / t
+            cells.append('%.3f (%.2fx, %.0f%%)' % (seconds, speedup, 100 * efficiency))
+            if seconds < sweep.time(size, best):
+                best = t
+            rows.append({'primitives': size, 'threads': t, 'seconds': seconds,
+                         'speedup': speedup, 'efficiency': efficiency})
+        # the thread count past which adding threads stopped paying off
+        lines.append('| %d | %s | %d |' % (size, ' | '.join(cells), best))
+    return lines, rows
+
+
+def weak_scaling(sweep, base_size, threads):
+    """The scene grows with the thread count, ideally the time stays the same."""
+    lines = ['### Weak scaling', '',
+             '%d primitives per thread, efficiency is the time of one unit of work over the time of t units '
+             'on t threads' % base_size, '',
+             '| threads | primitives | seconds | efficiency |', '| --- | --- | --- | --- |']
+    rows = []
+    t0 = sweep.time(base_size * threads[0], threads[0])
+    for t in threads:
+        size = base_size * t
+        seconds = sweep.time(size, t)
+        efficiency = t0 / seconds
+        lines.append('| %d | %d | %.3f | %.0f%% |' % (t, size, seconds, 100 * efficiency))
+        rows.append({'primitives': size, 'threads': t, 'seconds': seconds, 'efficiency': efficiency})
+    return lines, rows
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split('\n')[0])
+    scenegen.add_options(parser)
+    parser.set_defaults(imsize=(64, 64), lights=2)
+    parser.add_argument('--sizes', type=int_list, default=[250, 500, 1000, 2000],
+                        help='comma separated primitive counts for the strong scaling table')
+    parser.add_argument('--threads', type=int_list,
+                        default=sorted(set([1, 2, 4, os.cpu_count() or 1])),
+                        help='comma separated thread counts')
+    parser.add_argument('--weak-base', type=int, default=250, help='primitives per thread for weak scaling')
+    parser.add_argument('--sphere-share', type=scenegen.fraction, default=0.2,
+                        help='fraction of the primitives that are spheres')
+    parser.add_argument('--repeat', type=int, default=3, help='renders per point, the fastest one counts')
+    parser.add_argument('--raytracer', default=os.path.join(HERE, 'raytracer'))
+    parser.add_argument('--json', help='also write the measurements to this file')
+    args = parser.parse_args()
+    args.raytracer = os.path.abspath(args.raytracer)
+    threads = sorted(set(args.threads))
+
+    sweep = Sweep(args)
+    try:
+        # textures named on the command line are read from the working directory
+        if args.texture:
+            shutil.copy(args.texture, sweep.work)
+            args.texture = os.path.basename(args.texture)
+        strong, strong_rows = strong_scaling(sweep, args.sizes, threads)
+        weak, weak_rows = weak_scaling(sweep, args.weak_base, threads)
+    finally:
+        sweep.close()
+    print('\n'.join(strong + [''] + weak))
+    if args.json:
+        with open(args.json, 'w') as f:
+            json.dump({'strong': strong_rows, 'weak': weak_rows}, f, indent=2)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
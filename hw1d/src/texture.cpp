@@ -3,5 +3,94 @@
  *
  * @copyright 2022 Zecheng Qian, All rights reserved.
  */
+#include <algorithm>
 #include "texture.h"
 #include "color.h"
+
+void Texture::buildMipmap()
+{
+    this->mipmap.clear();
+    int level = 0;
+    while (this->getLevel(level).getWidth() > 1 || this->getLevel(level).getHeight() > 1)
+    {
+        const TiledImage<Rgba8> &src = this->getLevel(level);
+        int src_width = src.getWidth();
+        int src_height = src.getHeight();
+        // odd sizes round up so that the last row and column of the source are kept
+        TiledImage<Rgba8> dst((src_width + 1) / 2, (src_height + 1) / 2);
+        for (int j = 0; j < dst.getHeight(); j++)
+        {
+            // two source rows, the last row of an odd size is used twice
+            int j0 = std::min(2 * j, src_height - 1);
+            int j1 = std::min(2 * j + 1, src_height - 1);
+            for (int i = 0; i < dst.getWidth(); i++)
+            {
+                int i0 = std::min(2 * i, src_width - 1);
+                int i1 = std::min(2 * i + 1, src_width - 1);
+                const Rgba8 &t00 = src(i0, j0);
+                const Rgba8 &t10 = src(i1, j0);
+                const Rgba8 &t01 = src(i0, j1);
+                const Rgba8 &t11 = src(i1, j1);
+                // average the 2x2 block with rounding
+                Rgba8 &texel = dst(i, j);
+                texel.r = (t00.r + t10.r + t01.r + t11.r + 2) / 4;
+                texel.g = (t00.g + t10.g + t01.g + t11.g + 2) / 4;
+                texel.b = (t00.b + t10.b + t01.b + t11.b + 2) / 4;
+                texel.a = (t00.a + t10.a + t01.a + t11.a + 2) / 4;
+            }
+        }
+        this->mipmap.push_back(std::move(dst));
+        level++;
+    }
+}
+
+Color Texture::bilinear(int level, float u, float v) const
+{
+    const TiledImage<Rgba8> &checkerboard = this->getLevel(level);
+    int width = checkerboard.getWidth();
+    int height = checkerboard.getHeight();
+    float x = wrap_coordinate(u) * (width - 1);
+    float y = wrap_coordinate(v) * (height - 1);
+    int i = int(x);
+    int j = int(y);
+    float alpha = x - i;
+    float beta = y - j;
+    // clamp the neighbours to the edge of the image
+    int i1 = std::min(i + 1, width - 1);
+    int j1 = std::min(j + 1, height - 1);
+    // decode the 8-bit texels into colors on the fly
+    // the four texels usually share one tile, i.e. one cache line
+    Color pixel0 = this->decode(checkerboard(i, j));
+    Color pixel1 = this->decode(checkerboard(i1, j));
+    Color pixel2 = this->decode(checkerboard(i, j1));
+    Color pixel3 = this->decode(checkerboard(i1, j1));
+
+    return Color(pixel0 * (1 - alpha) * (1 - beta) +
+                 pixel1 * alpha * (1 - beta) +
+                 pixel2 * (1 - alpha) * beta +
+                 pixel3 * alpha * beta);
+}
+
+Color Texture::sample(float u, float v, float lod) const
+{
+    if (this->procedural_enable)
+    {
+        return this->procedural.evaluate(u, v, lod);
+    }
+    // convert the footprint to texels in the full resolution image
+    float lambda = lod + 0.5 * std::log2(float(this->getWidth()) * this->getHeight());
+    int max_level = this->getLevels() - 1;
+    if (!(lambda > 0) || max_level == 0)
+    {
+        // magnified, or no mipmap
+        return this->bilinear(0, u, v);
+    }
+    if (lambda >= max_level)
+    {
+        return this->bilinear(max_level, u, v);
+    }
+    // blend the two nearest levels
+    int level = int(lambda);
+    float t = lambda - level;
+    return this->bilinear(level, u, v) * (1 - t) + this->bilinear(level + 1, u, v) * t;
+}
@@ -7,44 +7,117 @@
 #define SRC_TEXTURE_H_
 
 #include <cstdlib>
+#include <cmath>
+#include <vector>
+#include "types.h"
 #include "color.h"
+#include "image.h"
+#include "procedural.h"
 
 class Texture
 {
     public:
-        // constructor
-        Texture(int width = 512, int height = 512, int max_val = 255, Color **checkerboard = NULL)
+        // constructor, the pixels are only allocated once the real size is known
+        Texture(int width = 0, int height = 0, int max_val = 255)
+            : checkerboard(width, height)
         {
-            this->width = width;
-            this->height = height;
-            this->max_val = max_val;
-            // initialize an empty checker board with size w*h
-            this->checkerboard = new Color *[width];
-            for (int i = 0; i < width; i++)
-            {
-                this->checkerboard[i] = new Color[height];
-            }
+            this->setMaxVal(max_val);
+            this->procedural_enable = false;
+        }
+
+        // constructor for a procedural texture, no image is allocated
+        explicit Texture(const Procedural &procedural)
+            : procedural(procedural)
+        {
+            this->setMaxVal(255);
+            this->procedural_enable = true;
         }
 
         // getter
-        int getWidth() const { return this->width; }
-        int getHeight() const { return this->height; }
+        int getWidth() const { return this->checkerboard.getWidth(); }
+        int getHeight() const { return this->checkerboard.getHeight(); }
         int getMaxVal() const { return this->max_val; }
-        Color **getCheckerboard() const { return this->checkerboard; }
-        const Color &getColor(int i, int j) const { return this->checkerboard[i][j]; }
-        
+        bool proceduralEnable() const { return this->procedural_enable; }
+        const Procedural &getProcedural() const { return this->procedural; }
+        TiledImage<Rgba8> &getCheckerboard() { return this->checkerboard; }
+        const TiledImage<Rgba8> &getCheckerboard() const { return this->checkerboard; }
+        Color getColor(int i, int j) const { return this->decode(this->checkerboard(i, j)); }
+        // number of mipmap levels, including the full resolution image
+        int getLevels() const { return 1 + this->mipmap.size(); }
+        // level 0 is the full resolution image, each level halves the size of the previous one
+        const TiledImage<Rgba8> &getLevel(int level) const { return level == 0 ? this->checkerboard : this->mipmap[level - 1]; }
+
         // setter
-        void setWidth(int width) { this->width = width; }
-        void setHeight(int height) { this->height = height; }
-        void setMaxVal(int max_val) { this->max_val = max_val; }
+        // also rebuild the table used to convert 8-bit values back to the range 0-1
+        void setMaxVal(int max_val)
+        {
+            this->max_val = max_val;
+            // values above 255 are rescaled by encode, so they decode against 255
+            int scale = std::min(max_val, 255);
+            for (int k = 0; k < 256; k++)
+            {
+                this->lut[k] = k * 1.0 / scale;
+            }
+        }
+        // append a mipmap level, the first one becomes the full resolution image
+        void appendLevel(TiledImage<Rgba8> &&level)
+        {
+            if (this->checkerboard.empty())
+            {
+                this->checkerboard = std::move(level);
+            }
+            else
+            {
+                this->mipmap.push_back(std::move(level));
+            }
+        }
+        // reallocate the image for a new size, the mipmap is dropped
+        void resize(int width, int height)
+        {
+            this->checkerboard.resize(width, height);
+            this->mipmap.clear();
+        }
+
+        // quantize a color component read from the file into 8 bits
+        // lossless when the maximum color value is at most 255
+        uint8_t encode(int value) const
+        {
+            if (this->max_val <= 255)
+            {
+                return uint8_t(value);
+            }
+            return uint8_t(std::round(value * 255.0 / this->max_val));
+        }
+
+        // convert a texel back to a color in the range 0-1
+        Color decode(const Rgba8 &texel) const
+        {
+            return Color(this->lut[texel.r], this->lut[texel.g], this->lut[texel.b]);
+        }
+
+        // build the mipmap pyramid from the full resolution image, by 2x2 box filtering
+        void buildMipmap();
+        // bi-linear interpolation of the texture coordinate (u, v) in one mipmap level,
+        // coordinates outside [0, 1] repeat the texture
+        Color bilinear(int level, float u, float v) const;
+        // tri-linear interpolation of the texture coordinate (u, v),
+        // or analytic evaluation for a procedural texture
+        // lod is the log2 of the footprint width in texture coordinate units,
+        // -INFINITY samples the full resolution image
+        Color sample(float u, float v, float lod = -INFINITY) const;
 
     private:
-        // size of the texture image
-        int width, height;
         // maximum color value
         int max_val;
-        // dynamically allocate a 2d array to store pixels in the image
-        Color **checkerboard;
+        // a tiled image to store pixels in the texture, 8 bits per channel
+        TiledImage<Rgba8> checkerboard;
+        // mipmap levels 1, 2, ... down to a single pixel
+        std::vector<TiledImage<Rgba8> > mipmap;
+        // lookup table from an 8-bit value to a color component
+        float lut[256];
+        // procedural textures replace the image by an analytic pattern
+        bool procedural_enable;
+        Procedural procedural;
 };
 
 #endif // SRC_TEXTURE_H_
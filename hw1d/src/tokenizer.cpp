@@ -0,0 +1,182 @@
+/**
+ * @file tokenizer.cpp
+ *
+ * @copyright 2022 Zecheng Qian, All rights reserved.
+ */
+#include <cstdint>
+#include <cstdlib>
+#include <cmath>
+#include <algorithm>
+#include "tokenizer.h"
+
+// exact powers of ten representable by a double
+static const double POW10[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                               1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+static bool is_space(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+static bool is_digit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+bool Tokenizer::readWord(const char *&begin, size_t &len)
+{
+    this->skipSpace();
+    begin = this->cur;
+    while (this->cur < this->last && !is_space(*this->cur))
+    {
+        this->cur++;
+    }
+    len = this->cur - begin;
+    return len > 0;
+}
+
+bool Tokenizer::readString(std::string &str)
+{
+    const char *begin;
+    size_t len;
+    if (!this->readWord(begin, len))
+    {
+        return false;
+    }
+    str.assign(begin, len);
+    return true;
+}
+
+bool Tokenizer::readFloat(float &value)
+{
+    this->skipSpace();
+    const char *p = this->cur;
+    const char *start = p;
+    bool negative = false;
+    if (p < this->last && (*p == '-' || *p == '+'))
+    {
+        negative = *p == '-';
+        p++;
+    }
+    // accumulate up to 19 significant digits into an integer mantissa
+    uint64_t mantissa = 0;
+    int digits = 0;
+    int exponent = 0;
+    bool any = false;
+    while (p < this->last && is_digit(*p))
+    {
+        if (digits < 19)
+        {
+            mantissa = mantissa * 10 + (*p - '0');
+            if (mantissa != 0)
+            {
+                digits++;
+            }
+        }
+        else
+        {
+            exponent++;
+        }
+        any = true;
+        p++;
+    }
+    if (p < this->last && *p == '.')
+    {
+        p++;
+        while (p < this->last && is_digit(*p))
+        {
+            if (digits < 19)
+            {
+                mantissa = mantissa * 10 + (*p - '0');
+                if (mantissa != 0)
+                {
+                    digits++;
+                }
+                exponent--;
+            }
+            any = true;
+            p++;
+        }
+    }
+    if (!any)
+    {
+        return false;
+    }
+    if (p < this->last && (*p == 'e' || *p == 'E'))
+    {
+        const char *q = p + 1;
+        bool exp_negative = false;
+        if (q < this->last && (*q == '-' || *q == '+'))
+        {
+            exp_negative = *q == '-';
+            q++;
+        }
+        if (q < this->last && is_digit(*q))
+        {
+            int e = 0;
+            while (q < this->last && is_digit(*q))
+            {
+                e = std::min(e * 10 + (*q - '0'), 10000);
+                q++;
+            }
+            exponent += exp_negative ? -e : e;
+            p = q;
+        }
+    }
+    if (p < this->last && !is_space(*p))
+    {
+        // not a plain number, leave the conversion of odd formats to the C library
+        std::string token(start, p);
+        while (p < this->last && !is_space(*p))
+        {
+            token += *p++;
+        }
+        char *stop;
+        double d = strtod(token.c_str(), &stop);
+        if (*stop != '\0')
+        {
+            return false;
+        }
+        value = float(d);
+        this->cur = p;
+        return true;
+    }
+    double d = double(mantissa);
+    if (exponent < 0)
+    {
+        // a single correctly rounded division while the power of ten is exact
+        d = -exponent <= 22 ? d / POW10[-exponent] : d * std::pow(10.0, exponent);
+    }
+    else if (exponent > 0)
+    {
+        d = exponent <= 22 ? d * POW10[exponent] : d * std::pow(10.0, exponent);
+    }
+    value = float(negative ? -d : d);
+    this->cur = p;
+    return true;
+}
+
+bool Tokenizer::readInt(int &value)
+{
+    this->skipSpace();
+    const char *p = this->cur;
+    bool negative = false;
+    if (p < this->last && (*p == '-' || *p == '+'))
+    {
+        negative = *p == '-';
+        p++;
+    }
+    if (p >= this->last || !is_digit(*p))
+    {
+        return false;
+    }
+    long v = 0;
+    while (p < this->last && is_digit(*p))
+    {
+        v = v * 10 + (*p - '0');
+        p++;
+    }
+    value = int(negative ? -v : v);
+    this->cur = p;
+    return true;
+}
@@ -0,0 +1,82 @@
+/**
+ * @file tokenizer.h
+ *
+ * @copyright 2022 Zecheng Qian, All rights reserved.
+ */
+#ifndef SRC_TOKENIZER_H_
+#define SRC_TOKENIZER_H_
+
+#include <cstddef>
+#include <cstring>
+#include <string>
+
+// splits a range of characters into whitespace separated tokens in place,
+// without copying, and converts numbers with a hand-rolled scanner
+// line breaks count as whitespace, use nextLine to split the range into lines first
+class Tokenizer
+{
+    public:
+        // constructor, tokenize the range [begin, end)
+        Tokenizer(const char *begin, const char *end)
+            : cur(begin), last(end)
+        {
+        }
+
+        // getter
+        const char *position() const { return this->cur; }
+        bool done() { this->skipSpace(); return this->cur == this->last; }
+
+        // skip spaces and tabs, and also line breaks if the flag is set
+        void skipSpace(bool newline = true)
+        {
+            while (this->cur < this->last &&
+                   (*this->cur == ' ' || *this->cur == '\t' || *this->cur == '\r' ||
+                    (newline && *this->cur == '\n')))
+            {
+                this->cur++;
+            }
+        }
+
+        // move past the end of the current line, return the range of the line
+        // the returned range excludes the line break
+        void nextLine(const char *&begin, const char *&end)
+        {
+            begin = this->cur;
+            const char *nl = static_cast<const char *>(memchr(this->cur, '\n', this->last - this->cur));
+            end = nl == NULL ? this->last : nl;
+            this->cur = nl == NULL ? this->last : nl + 1;
+        }
+
+        // read the next token as a word, return false if there is none
+        bool readWord(const char *&begin, size_t &len);
+        // read the next token as a string
+        bool readString(std::string &str);
+        // read the next token as a float
+        bool readFloat(float &value);
+        // read the next token as an integer
+        bool readInt(int &value);
+        // check whether the next character is c, and consume it if so
+        bool accept(char c)
+        {
+            if (this->cur < this->last && *this->cur == c)
+            {
+                this->cur++;
+                return true;
+            }
+            return false;
+        }
+
+    private:
+        // current position
+        const char *cur;
+        // end of the range
+        const char *last;
+};
+
+// whether the word [begin, begin + len) equals the keyword
+inline bool word_equal(const char *begin, size_t len, const char *keyword)
+{
+    return strlen(keyword) == len && memcmp(begin, keyword, len) == 0;
+}
+
+#endif // SRC_TOKENIZER_H_
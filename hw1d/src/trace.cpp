@@ -0,0 +1,181 @@
+/**
+ * @file trace.cpp
+ *
+ * @copyright 2022 Zecheng Qian, All rights reserved.
+ */
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <mutex>
+#include <vector>
+#include "trace.h"
+
+// spans kept per thread, about 6 MB each, allocated by the first span of a thread
+#define TRACE_CAPACITY 65536
+// characters of the detail kept with a span
+#define TRACE_DETAIL 48
+
+namespace
+{
+typedef struct TraceEventType
+{
+    const char *name;
+    const char *category;
+    char detail[TRACE_DETAIL];
+    int index;
+    int64_t begin, end;
+} TraceEvent;
+
+// the ring buffer of one thread, only that thread writes to it
+typedef struct TraceBufferType
+{
+    int tid;
+    uint64_t count; // spans recorded, the last TRACE_CAPACITY of them are kept
+    std::vector<TraceEvent> events;
+} TraceBuffer;
+
+const char *trace_path = getenv("RAYTRACER_TRACE");
+std::chrono::steady_clock::time_point trace_start = std::chrono::steady_clock::now();
+std::mutex trace_mutex;
+// the buffers are never freed, the spans of a thread outlive it
+std::vector<TraceBuffer *> trace_buffers;
+thread_local TraceBuffer *local_buffer = NULL;
+
+TraceBuffer &thread_buffer()
+{
+    if (local_buffer == NULL)
+    {
+        TraceBuffer *buffer = new TraceBuffer();
+        buffer->count = 0;
+        buffer->events.resize(TRACE_CAPACITY);
+        std::lock_guard<std::mutex> lock(trace_mutex);
+        buffer->tid = int(trace_buffers.size());
+        trace_buffers.push_back(buffer);
+        local_buffer = buffer;
+    }
+    return *local_buffer;
+}
+
+int64_t trace_now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - trace_start).count();
+}
+
+// write a string as a json string literal
+void write_json_string(FILE *file, const char *s)
+{
+    fputc('"', file);
+    for (; *s != '\0'; s++)
+    {
+        unsigned char c = *s;
+        if (c == '"' || c == '\\')
+        {
+            fprintf(file, "\\%c", c);
+        }
+        else if (c < 0x20)
+        {
+            fprintf(file, "\\u%04x", c);
+        }
+        else
+        {
+            fputc(c, file);
+        }
+    }
+    fputc('"', file);
+}
+} // namespace
+
+bool trace_enabled()
+{
+    return trace_path != NULL && trace_path[0] != '\0';
+}
+
+TraceSpan::TraceSpan(const char *name, const char *category, const std::string &detail, int index)
+    : name(name), category(category), index(index), begin(-1)
+{
+    if (trace_enabled())
+    {
+        // register the thread before its first span starts, so the main thread comes first
+        thread_buffer();
+        this->detail = detail;
+        this->begin = trace_now();
+    }
+}
+
+TraceSpan::~TraceSpan()
+{
+    if (this->begin < 0)
+    {
+        return;
+    }
+    TraceBuffer &buffer = thread_buffer();
+    TraceEvent &event = buffer.events[buffer.count % TRACE_CAPACITY];
+    buffer.count++;
+    event.name = this->name;
+    event.category = this->category;
+    strncpy(event.detail, this->detail.c_str(), TRACE_DETAIL - 1);
+    event.detail[TRACE_DETAIL - 1] = '\0';
+    event.index = this->index;
+    event.begin = this->begin;
+    event.end = trace_now();
+}
+
+void write_trace()
+{
+    if (!trace_enabled())
+    {
+        return;
+    }
+    FILE *file = fopen(trace_path, "w");
+    if (file == NULL)
+    {
+        fprintf(stderr, "Could not open output stream with file %s\n", trace_path);
+        return;
+    }
+    std::lock_guard<std::mutex> lock(trace_mutex);
+    uint64_t dropped = 0;
+    fprintf(file, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+    fprintf(file, "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": 1, \"args\": {\"name\": \"raytracer\"}}");
+    for (size_t b = 0; b < trace_buffers.size(); b++)
+    {
+        const TraceBuffer &buffer = *trace_buffers[b];
+        fprintf(file, ",\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": %d, "
+                      "\"args\": {\"name\": \"%s %d\"}}",
+                buffer.tid, buffer.tid == 0 ? "main" : "thread", buffer.tid);
+        uint64_t first = buffer.count > TRACE_CAPACITY ? buffer.count - TRACE_CAPACITY : 0;
+        dropped += first;
+        for (uint64_t k = first; k < buffer.count; k++)
+        {
+            const TraceEvent &event = buffer.events[k % TRACE_CAPACITY];
+            // complete events, times in microseconds
+            fprintf(file, ",\n{\"name\": ");
+            write_json_string(file, event.name);
+            fprintf(file, ", \"cat\": ");
+            write_json_string(file, event.category);
+            fprintf(file, ", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, \"ts\": %.3f, \"dur\": %.3f",
+                    buffer.tid, event.begin / 1000.0, (event.end - event.begin) / 1000.0);
+            if (event.detail[0] != '\0' || event.index >= 0)
+            {
+                fprintf(file, ", \"args\": {");
+                if (event.detail[0] != '\0')
+                {
+                    fprintf(file, "\"detail\": ");
+                    write_json_string(file, event.detail);
+                }
+                if (event.index >= 0)
+                {
+                    fprintf(file, "%s\"index\": %d", event.detail[0] != '\0' ? ", " : "", event.index);
+                }
+                fprintf(file, "}");
+            }
+            fprintf(file, "}");
+        }
+    }
+    fprintf(file, "\n]}\n");
+    fclose(file);
+    if (dropped > 0)
+    {
+        fprintf(stderr, "Trace buffers were full, the oldest %llu spans were dropped\n", (unsigned long long)dropped);
+    }
+}
@@ -0,0 +1,42 @@
+/**
+ * @file trace.h
+ *
+ * @copyright 2022 Zecheng Qian, All rights reserved.
+ */
+#ifndef SRC_TRACE_H_
+#define SRC_TRACE_H_
+
+#include <cstdint>
+#include <string>
+
+// a timeline of the render phases in the Chrome trace event format, viewable in Perfetto
+// or chrome://tracing, recorded when RAYTRACER_TRACE names the json file to write
+// every thread records into its own ring buffer, so spans cost no locking,
+// when a buffer is full the oldest spans of that thread are dropped
+
+// whether RAYTRACER_TRACE is set
+bool trace_enabled();
+
+// a span of work on the calling thread, from construction to destruction
+// name and category must outlive the program, string literals in practice
+// detail is shown with the span, e.g. a filename, and index e.g. a row, -1 for none
+class TraceSpan
+{
+    public:
+        TraceSpan(const char *name, const char *category, const std::string &detail = std::string(), int index = -1);
+        ~TraceSpan();
+
+    private:
+        const char *name;
+        const char *category;
+        std::string detail;
+        int index;
+        // start in nanoseconds since the first span, -1 when tracing is off
+        int64_t begin;
+};
+
+// write every recorded span to the RAYTRACER_TRACE file,
+// call once the other threads are done
+void write_trace();
+
+#endif // SRC_TRACE_H_
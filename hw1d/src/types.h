@@ -8,7 +8,10 @@
 
 #include <vector>
 #include <cmath>
+#include <cstdint>
+#include <algorithm>
 #include "color.h"
+#include "simd.h"
 
 // const
 #define MAX_VAL 255
@@ -84,11 +87,22 @@ struct FloatVec3
     {
     }
 
+    // constructor from the first three lanes of a SIMD vector
+    explicit FloatVec3(const Vec4f &v)
+        : first(v.x()), second(v.y()), third(v.z())
+    {
+    }
+
+    // load into a SIMD vector, the storage stays 12 bytes so that vertex arrays are packed
+    Vec4f simd() const
+    {
+        return Vec4f(this->first, this->second, this->third);
+    }
+
     // normalization
     FloatVec3 normal() const
     {
-        float norm = sqrt(this->first * this->first + this->second * this->second + this->third * this->third);
-        return FloatVec3(this->first / norm, this->second / norm, this->third / norm);
+        return FloatVec3(normalize3(this->simd()));
     }
 
     // cross product
@@ -136,31 +150,68 @@ struct FloatVec3
     }
 };
 
-typedef struct VertexType
+// packed 8-bit texel of a color texture, 4 bytes instead of 3 floats
+typedef struct Rgba8Type
 {
-    // object id (index into the list)
-    int obj_idx;
-    // position of the vertex
-    FloatVec3 p;
-} Vertex;
-
-// for smooth shading
-typedef struct VertexNormalType
+    uint8_t r, g, b, a;
+} Rgba8;
+
+// unit normal stored in the octahedral encoding with two 16-bit components
+// the sphere is projected onto the octahedron |x| + |y| + |z| = 1, whose
+// lower half is folded over the upper half, and the result is quantized
+// the decoded normal is always unit length, the angular error is below 0.05 degree
+typedef struct OctNormalType
 {
-    // object id (index into the list)
-    int obj_idx;
-    // unit normal vector
-    FloatVec3 n;
-} VertexNormal;
-
-// for texture mapping
-typedef struct TextureCoordinateType
+    uint16_t x, y;
+
+    // default constructor, encode the direction (0, 0, 1)
+    OctNormalType() : x(32768), y(32768)
+    {
+    }
+
+    // encode a direction, it does not need to be normalized
+    explicit OctNormalType(const FloatVec3 &n)
+    {
+        float l1 = std::abs(n.first) + std::abs(n.second) + std::abs(n.third);
+        float px = 0, py = 0;
+        if (l1 > 0)
+        {
+            px = n.first / l1;
+            py = n.second / l1;
+            if (n.third < 0)
+            {
+                // fold the lower hemisphere over the diagonals
+                float fx = (1 - std::abs(py)) * (px >= 0 ? 1 : -1);
+                float fy = (1 - std::abs(px)) * (py >= 0 ? 1 : -1);
+                px = fx;
+                py = fy;
+            }
+        }
+        this->x = uint16_t(std::round((px * 0.5f + 0.5f) * 65535));
+        this->y = uint16_t(std::round((py * 0.5f + 0.5f) * 65535));
+    }
+
+    // decode back to a unit normal
+    FloatVec3 decode() const
+    {
+        float px = this->x * (2.0f / 65535) - 1;
+        float py = this->y * (2.0f / 65535) - 1;
+        float pz = 1 - std::abs(px) - std::abs(py);
+        // unfold the lower hemisphere
+        float t = std::max(-pz, 0.0f);
+        px += px >= 0 ? -t : t;
+        py += py >= 0 ? -t : t;
+        return FloatVec3(px, py, pz).normal();
+    }
+} OctNormal;
+
+// the vertex indices of a triangle, the only part of a triangle read while intersecting
+// kept apart from the shading attributes in Triangle so more triangles fit in the cache
+typedef struct TriangleVerticesType
 {
-    // object id (index into the list)
-    int obj_idx;
-    // texture coordinate
-    FloatVec2 vt;
-} TextureCoordinate;
+    // indices into the vertex list, starting from 0
+    int v0, v1, v2;
+} TriangleVertices;
 
 typedef struct LightType
 {
@@ -194,6 +245,14 @@ typedef struct AttLightType : Light
     }
 } AttLight;
 
+// kind of object a ray hits, OBJ_NONE if it hits nothing
+enum ObjType
+{
+    OBJ_NONE,
+    OBJ_SPHERE,
+    OBJ_TRIANGLE
+};
+
 typedef struct DepthCueType
 {
     // depth cue color
@@ -11,8 +11,13 @@
 #include <tuple>
 #include "utils.h"
 #include "types.h"
+#include "intersect.h"
+#include "fastmath.h"
+#include "stats.h"
+#include "perf_counters.h"
+#include "raylog.h"
 
-void output_image(std::string filename, Color **checkerboard, int width, int height)
+void output_image(std::string filename, const Image<Color> &checkerboard, int width, int height)
 {
     std::ofstream outputstream(filename, std::ios::out);
 
@@ -31,11 +36,12 @@ void output_image(std::string filename, Color **checkerboard, int width, int hei
     // fill in color for each pixel
     for (uint32_t y = 0; y < height; y++)
     {
+        const Color *row = checkerboard.row(y);
         for (uint32_t x = 0; x < width; x++)
         {
-            outputstream << (int)(checkerboard[x][y].getR() * MAX_VAL) << " "
-                         << (int)(checkerboard[x][y].getG() * MAX_VAL) << " "
-                         << (int)(checkerboard[x][y].getB() * MAX_VAL) << " ";
+            outputstream << (int)(row[x].getR() * MAX_VAL) << " "
+                         << (int)(row[x].getG() * MAX_VAL) << " "
+                         << (int)(row[x].getB() * MAX_VAL) << " ";
             pixel_counter++;
             // start a new line if 4 pixels are filled
             if (pixel_counter % 4 == 0)
@@ -52,17 +58,17 @@ void output_image(std::string filename, Color **checkerboard, int width, int hei
 
 float distance_between_2D_points(FloatVec2 point1, FloatVec2 point2)
 {
-    float sum = pow(point1.first - point2.first, 2) 
-            + pow(point1.second - point2.second, 2);
+    float sum = ipow<2>(point1.first - point2.first) 
+            + ipow<2>(point1.second - point2.second);
 
     return sqrt(sum);
 }
 
 float distance_between_3D_points(FloatVec3 point1, FloatVec3 point2)
 {
-    float sum = pow(point1.first - point2.first, 2) 
-            + pow(point1.second - point2.second, 2)
-            + pow(point1.third - point2.third, 2);
+    float sum = ipow<2>(point1.first - point2.first) 
+            + ipow<2>(point1.second - point2.second)
+            + ipow<2>(point1.third - point2.third);
     
     return sqrt(sum);
 }
@@ -110,14 +116,14 @@ void view_window_init(const Scene &scene, ViewWindow &viewwindow, float viewdist
     viewwindow.dv = (viewwindow.ll - viewwindow.ul) / (height - 1);   
 }
 
-const MaterialColor &get_material(const Scene &scene, std::string obj_type, int obj_idx)
+const MaterialColor &get_material(const Scene &scene, ObjType obj_type, int obj_idx)
 {
     
-    if (obj_type == "Sphere")
+    if (obj_type == OBJ_SPHERE)
     {
         return scene.getMaterialList()[scene.getSphereList()[obj_idx].getMidx()];
     }
-    else if (obj_type == "Triangle")
+    else if (obj_type == OBJ_TRIANGLE)
     {
         return scene.getMaterialList()[scene.getTriangleList()[obj_idx].getMidx()];
     }
@@ -128,30 +134,30 @@ const MaterialColor &get_material(const Scene &scene, std::string obj_type, int
     }
 }
 
-FloatVec3 get_normal(const Scene &scene, std::string obj_type, int obj_idx, FloatVec3 &p)
+FloatVec3 get_normal(const Scene &scene, ObjType obj_type, int obj_idx, FloatVec3 &p)
 {
-    if (obj_type == "Sphere")
+    if (obj_type == OBJ_SPHERE)
     {
         return scene.getSphereList()[obj_idx].normal(p);
     }
-    else if (obj_type == "Triangle")
+    else if (obj_type == OBJ_TRIANGLE)
     {
-        return scene.getTriangleList()[obj_idx].normal(scene ,p);
+        return scene.getTriangleList()[obj_idx].normal(scene, scene.getTriangleVertexList()[obj_idx], p);
     }
     // placeholder for other types of objects
     else
     {
-        return scene.getTriangleList()[obj_idx].normal(scene, p);
+        return scene.getTriangleList()[obj_idx].normal(scene, scene.getTriangleVertexList()[obj_idx], p);
     }
 }
 
-bool texture_map_enabled(const Scene &scene, std::string obj_type, int obj_idx)
+bool texture_map_enabled(const Scene &scene, ObjType obj_type, int obj_idx)
 {
-    if (obj_type == "Sphere")
+    if (obj_type == OBJ_SPHERE)
     {
         return (scene.getSphereList()[obj_idx].getTextureidx() != -1);
     }
-    else if (obj_type == "Triangle")
+    else if (obj_type == OBJ_TRIANGLE)
     {
         return scene.getTriangleList()[obj_idx].getTextureMap();
     }
@@ -162,13 +168,13 @@ bool texture_map_enabled(const Scene &scene, std::string obj_type, int obj_idx)
     }
 }
 
-bool normal_map_enabled(const Scene &scene, std::string obj_type, int obj_idx)
+bool normal_map_enabled(const Scene &scene, ObjType obj_type, int obj_idx)
 {
-    if (obj_type == "Sphere")
+    if (obj_type == OBJ_SPHERE)
     {
         return scene.getSphereList()[obj_idx].getBumpidx() != -1;
     }
-    else if (obj_type == "Triangle")
+    else if (obj_type == OBJ_TRIANGLE)
     {
         return (scene.getTriangleList()[obj_idx].getBumpidx() != -1);
     }
@@ -179,14 +185,14 @@ bool normal_map_enabled(const Scene &scene, std::string obj_type, int obj_idx)
     }
 }
 
-const Texture &get_texture(const Scene &scene, std::string obj_type, int obj_idx)
+const Texture &get_texture(const Scene &scene, ObjType obj_type, int obj_idx)
 {
-    if (obj_type == "Sphere")
+    if (obj_type == OBJ_SPHERE)
     {
         const Texture &texture = scene.getTextureList()[scene.getSphereList()[obj_idx].getTextureidx()];
         return texture;
     }
-    else if (obj_type == "Triangle")
+    else if (obj_type == OBJ_TRIANGLE)
     {
         const Texture &texture = scene.getTextureList()[scene.getTriangleList()[obj_idx].getTextureidx()];
         return texture;
@@ -199,14 +205,14 @@ const Texture &get_texture(const Scene &scene, std::string obj_type, int obj_idx
     }
 }
 
-const Bump &get_normal_map(const Scene &scene, std::string obj_type, int obj_idx)
+const Bump &get_normal_map(const Scene &scene, ObjType obj_type, int obj_idx)
 {
-    if (obj_type == "Sphere")
+    if (obj_type == OBJ_SPHERE)
     {
         const Bump &bump = scene.getBumpList()[scene.getSphereList()[obj_idx].getBumpidx()];
         return bump;
     }
-    else if (obj_type == "Triangle")
+    else if (obj_type == OBJ_TRIANGLE)
     {
         const Bump &bump = scene.getBumpList()[scene.getTriangleList()[obj_idx].getBumpidx()];
         return bump;
@@ -219,77 +225,96 @@ const Bump &get_normal_map(const Scene &scene, std::string obj_type, int obj_idx
     }
 }
 
-FloatVec2 get_texture_coordinate(const Scene &scene, std::string obj_type, int obj_idx, FloatVec3 &p)
+FloatVec2 get_texture_coordinate(const Scene &scene, ObjType obj_type, int obj_idx, FloatVec3 &p)
 {
     FloatVec2 texture_cor;
-    if (obj_type == "Sphere")
+    if (obj_type == OBJ_SPHERE)
     {
         texture_cor = scene.getSphereList()[obj_idx].texture_coordinate(p);
     }
-    else if (obj_type == "Triangle")
+    else if (obj_type == OBJ_TRIANGLE)
     {
-        texture_cor = scene.getTriangleList()[obj_idx].texture_coordinate(scene, p);
+        texture_cor = scene.getTriangleList()[obj_idx].texture_coordinate(scene, scene.getTriangleVertexList()[obj_idx], p);
     }
     // placeholder for other types of objects
     else
     {
-        texture_cor = scene.getTriangleList()[obj_idx].texture_coordinate(scene, p);
+        texture_cor = scene.getTriangleList()[obj_idx].texture_coordinate(scene, scene.getTriangleVertexList()[obj_idx], p);
     }
 
     return texture_cor;
 }
 
-Color get_color(const Scene &scene, std::string obj_type, int obj_idx, FloatVec3 &p)
+float texture_footprint(const Scene &scene, ObjType obj_type, int obj_idx, const Ray &ray, float ray_t, FloatVec3 &p)
 {
+    // width of the ray cone at the intersection point
+    float width = ray.coneWidth(ray_t);
+    if (!(width > 0))
+    {
+        return -INFINITY;
+    }
+    // the footprint is stretched when the surface is seen at a grazing angle
+    FloatVec3 N = get_normal(scene, obj_type, obj_idx, p);
+    float cos_theta = std::max(float(1e-3), std::abs(N.dot(ray.getDir().normal())));
+    // change of texture coordinate per unit length on the surface
+    float uv_per_length = 0;
+    if (obj_type == OBJ_SPHERE)
+    {
+        // u wraps around a circle of radius r*sin(theta), v spans half a great circle
+        const Sphere &sphere = scene.getSphereList()[obj_idx];
+        float r = sphere.getRadius();
+        float sin_theta = std::max(float(1e-2), std::sqrt(std::max(float(0), 1 - N.third * N.third)));
+        uv_per_length = std::sqrt(1 / (2 * PI * r * sin_theta) * 1 / (PI * r));
+    }
+    else
+    {
+        // ratio between the areas of the triangle in texture space and in world space
+        const Triangle &triangle = scene.getTriangleList()[obj_idx];
+        const TriangleVertices &vertices = scene.getTriangleVertexList()[obj_idx];
+        FloatVec3 p0 = scene.getVertexList()[vertices.v0];
+        FloatVec3 p1 = scene.getVertexList()[vertices.v1];
+        FloatVec3 p2 = scene.getVertexList()[vertices.v2];
+        FloatVec2 vt0 = scene.getTextureCoordinateList()[triangle.getVt0idx()];
+        FloatVec2 vt1 = scene.getTextureCoordinateList()[triangle.getVt1idx()];
+        FloatVec2 vt2 = scene.getTextureCoordinateList()[triangle.getVt2idx()];
+        FloatVec2 d1 = vt1 - vt0;
+        FloatVec2 d2 = vt2 - vt0;
+        float uv_area = std::abs(d1.first * d2.second - d1.second * d2.first);
+        FloatVec3 c = (p1 - p0).cross(p2 - p0);
+        float world_area = std::sqrt(c.dot(c));
+        if (!(world_area > 0))
+        {
+            return -INFINITY;
+        }
+        uv_per_length = std::sqrt(uv_area / world_area);
+    }
+
+    return std::log2(width / cos_theta * uv_per_length);
+}
+
+Color get_color(const Scene &scene, ObjType obj_type, int obj_idx, FloatVec3 &p, float lod)
+{
+    PERF_SCOPE(PERF_TEXTURE);
     FloatVec2 texture_cor = get_texture_coordinate(scene, obj_type, obj_idx, p);
     const Texture &texture = get_texture(scene, obj_type, obj_idx);
-    int width = texture.getWidth();
-    int height = texture.getHeight();
-    Color **checkerboard = texture.getCheckerboard();
-    float u = texture_cor.first;
-    float v = texture_cor.second;
-    // bi-linear interpolation to get the color from the texture image
-    float x = u * (width - 1);
-    float y = v * (height - 1);
-    int i = int(x);
-    int j = int(y);
-    float alpha = x - i;
-    float beta = y - j;
-    Color pixel0 = checkerboard[i][j];
-    Color pixel1 = checkerboard[i+1][j];
-    Color pixel2 = checkerboard[i][j+1];
-    Color pixel3 = checkerboard[i+1][j+1];
-
-    return Color(pixel0 * (1 - alpha) * (1 - beta) +
-                 pixel1 * alpha * (1 - beta) +
-                 pixel2 * (1 - alpha) * beta +
-                 pixel3 * alpha * beta);
+    // tri-linear interpolation to get the color from the texture mipmap
+    return texture.sample(texture_cor.first, texture_cor.second, lod);
 }
 
-FloatVec3 normal_mapping(const Scene &scene, std::string obj_type, int obj_idx, FloatVec3 &p)
+FloatVec3 normal_mapping(const Scene &scene, ObjType obj_type, int obj_idx, FloatVec3 &p, float lod)
 {
+    PERF_SCOPE(PERF_TEXTURE);
     // first get the texture coordinate of the object
     FloatVec2 texture_cor = get_texture_coordinate(scene, obj_type, obj_idx, p);
-    const Texture &texture = get_texture(scene, obj_type, obj_idx);
     const Bump &bump = get_normal_map(scene, obj_type, obj_idx);
     // get the surface normal
     FloatVec3 N = get_normal(scene, obj_type, obj_idx, p);
-    int width = texture.getWidth();
-    int height = texture.getHeight();
-    // pixel coordinate
-    float u = texture_cor.first;
-    float v = texture_cor.second;
-    float x = u * (width - 1);
-    float y = v * (height - 1);
-    // convert to pixel coordinate in the normal map
-    // use nearest neighboor for simplicity
-    int i = std::round(x);
-    int j = std::round(y);
     // retrieve the normal direction from the normal map
-    FloatVec3 m = bump.getNormal(i, j);
+    // tri-linear interpolation in the mipmap
+    FloatVec3 m = bump.sample(texture_cor.first, texture_cor.second, lod);
     // calculate the modified normal
     // consider differently for spheres and triangles
-    if (obj_type == "Sphere")
+    if (obj_type == OBJ_SPHERE)
     {
         FloatVec3 N = get_normal(scene, obj_type, obj_idx, p);
         FloatVec3 T(-N.second / sqrt(N.first * N.first + N.second * N.second),
@@ -302,16 +327,17 @@ FloatVec3 normal_mapping(const Scene &scene, std::string obj_type, int obj_idx,
         float nz = T.third * m.first + B.third * m.second + N.third * m.third;
         return FloatVec3(nx, ny, nz);
     }
-    else if (obj_type == "Triangle")
+    else if (obj_type == OBJ_TRIANGLE)
     {
         // get three vertices of the triangle
         const Triangle& triangle = scene.getTriangleList()[obj_idx];
-        FloatVec3 p0 = scene.getVertexList()[triangle.getV0idx()- 1].p;
-        FloatVec3 p1 = scene.getVertexList()[triangle.getV1idx() - 1].p;
-        FloatVec3 p2 = scene.getVertexList()[triangle.getV2idx() - 1].p;
-        FloatVec2 texture_cor0 = scene.getTextureCoordinateList()[triangle.getVt0idx() - 1].vt;
-        FloatVec2 texture_cor1 = scene.getTextureCoordinateList()[triangle.getVt1idx() - 1].vt;
-        FloatVec2 texture_cor2 = scene.getTextureCoordinateList()[triangle.getVt2idx() - 1].vt;
+        const TriangleVertices &vertices = scene.getTriangleVertexList()[obj_idx];
+        FloatVec3 p0 = scene.getVertexList()[vertices.v0];
+        FloatVec3 p1 = scene.getVertexList()[vertices.v1];
+        FloatVec3 p2 = scene.getVertexList()[vertices.v2];
+        FloatVec2 texture_cor0 = scene.getTextureCoordinateList()[triangle.getVt0idx()];
+        FloatVec2 texture_cor1 = scene.getTextureCoordinateList()[triangle.getVt1idx()];
+        FloatVec2 texture_cor2 = scene.getTextureCoordinateList()[triangle.getVt2idx()];
         float delta_u1 = texture_cor1.first - texture_cor0.first;
         float delta_v1 = texture_cor1.second - texture_cor0.second;
         float delta_u2 = texture_cor2.first - texture_cor1.first;
@@ -334,136 +360,215 @@ FloatVec3 normal_mapping(const Scene &scene, std::string obj_type, int obj_idx,
     }
 }
 
-Color shade_ray(const Scene &scene, std::string obj_type, int obj_idx, const Ray &ray, float ray_t)
+// what the lighting of one hit needs, worked out once per hit rather than once per light
+typedef struct ShadeContextType
 {
-    // use The Phong Illumination Model to determine the color of the intersecting point
-    // return the corresponding color for that object
-    // the surface normal should be consider differently for sphere and cylinder
-    // compute the intersection point
-    FloatVec3 p = ray.extend(ray_t);
-    const MaterialColor &cur_material = get_material(scene, obj_type, obj_idx);
-    Color Od_lambda = cur_material.getOd();
-    // compute the coresponding color from the texture coordinate
-    if (texture_map_enabled(scene, obj_type, obj_idx))
+    FloatVec3 p;         // intersection point
+    Vec4f N;             // surface normal, after normal mapping
+    Vec4f V;             // unit vector towards the viewer
+    Vec4f Od, Os;        // diffuse and specular colors, after texture mapping
+    float kd, ks, n;     // material coefficients
+} ShadeContext;
+
+// one light's contribution before its specular power is taken
+// the powers of several lights are then taken together with the 4-lane fast_pow
+typedef struct LightTermType
+{
+    Vec4f diffuse;  // diffuse color times the cosine of the light angle
+    float cos_h;    // the cosine raised to the specular exponent
+    float scale;    // shadowing, attenuation and light intensity
+} LightTerm;
+
+// kind of a light source, decided once per light from its w component
+enum LightKind
+{
+    LIGHT_POINT,
+    LIGHT_DIRECTIONAL,
+    LIGHT_NONE // neither, contributes no direction
+};
+
+static inline LightKind light_kind(const Light &light)
+{
+    if (std::abs(light.w - 1) < 1e-6)
     {
-        // std::cout << "I'm here" << std::endl;
-        Od_lambda = get_color(scene, obj_type, obj_idx, p);
+        return LIGHT_POINT;
     }
-    float Ir, Ig, Ib;
-    float sum_r = cur_material.getKa() * Od_lambda.getR();
-    float sum_g = cur_material.getKa() * Od_lambda.getG();
-    float sum_b = cur_material.getKa() * Od_lambda.getB();
-    Color res_color;
-    float f_att = 1; // light source attenuation factor
-    const std::vector<Light> &light_list = scene.getLightList();
-    const std::vector<AttLight> &attlight_list = scene.getAttLightList();
-    // light intensity for each component, just take the average for simplicity
-    float IL = 1.0 / (light_list.size() + attlight_list.size());
-    // illumination for normal light
-    for (int i = 0; i < light_list.size(); i++)
+    if (std::abs(light.w - 0) < 1e-6)
     {
-        Light light = light_list[i];
-        res_color = light_shade(scene, ray, ray_t, light, obj_type, obj_idx);
-        Ir = res_color.getR();
-        Ig = res_color.getG();
-        Ib = res_color.getB();
-
-        sum_r += IL * Ir;
-        sum_g += IL * Ig;
-        sum_b += IL * Ib;
+        return LIGHT_DIRECTIONAL;
     }
+    return LIGHT_NONE;
+}
 
-    // illumination for attenuated light
-    for (int i = 0; i < attlight_list.size(); i++)
-    {
-        AttLight attlight = attlight_list[i];
-        res_color = light_shade(scene, ray, ray_t, attlight, obj_type, obj_idx);
-        Ir = res_color.getR();
-        Ig = res_color.getG();
-        Ib = res_color.getB();
-        if ((attlight.w - 1) < 1e-6)
-        {
-            f_att = light_attenuation(p, attlight);
-        }
+// attenuation factor of a light at the point p, plain lights do not attenuate
+static inline float attenuation(const FloatVec3 &p, const Light &light)
+{
+    return 1;
+}
 
-        sum_r += f_att * IL * Ir;
-        sum_g += f_att * IL * Ig;
-        sum_b += f_att * IL * Ib;
+static inline float attenuation(const FloatVec3 &p, const AttLight &light)
+{
+    return light_attenuation(p, light);
+}
+
+// illuminate the hit with one light using the Phong Illumination Model, scaled by the light intensity IL
+// specialized on the kind of light so the body has no branches besides the shadow ray
+template <LightKind KIND, typename LightT>
+static inline LightTerm light_kernel(const Scene &scene, const ShadeContext &ctx, const LightT &light, float IL)
+{
+    // calculate vector L
+    FloatVec3 L;
+    if (KIND == LIGHT_POINT)
+    {
+        L = FloatVec3(normalize3(Vec4f(light.x, light.y, light.z) - ctx.p.simd()));
     }
+    else if (KIND == LIGHT_DIRECTIONAL)
+    {
+        L = FloatVec3(normalize3(-Vec4f(light.x, light.y, light.z)));
+    }
+    // calculate vector H
+    Vec4f H = normalize3_fast(ctx.V + L.simd());
 
-    // clamping
-    sum_r = std::min(float(1.0), sum_r);
-    sum_g = std::min(float(1.0), sum_g);
-    sum_b = std::min(float(1.0), sum_b);
+    // check for shadowing effect
+    // cast a second ray forwarding from the intersection point to the light source
+    FloatVec3 p = ctx.p;
+    Ray ray_second(p, L);
+    float shadow = shadow_check(scene, ray_second, light, RAY_SHADOW);
+
+    float term1 = std::max(float(0), dot3(ctx.N, L.simd()));
+    LightTerm term;
+    // the three color channels at once
+    term.diffuse = ctx.Od * ctx.kd * term1;
+    term.cos_h = std::max(float(0), dot3(ctx.N, H));
+    term.scale = shadow * (attenuation(ctx.p, light) * IL);
+    return term;
+}
 
-    // apply depth cueing if enabled
-    if (scene.depthCueEnable())
+// pick the kernel for the kind of the light
+template <typename LightT>
+static inline LightTerm light_shade(const Scene &scene, const ShadeContext &ctx, const LightT &light, float IL)
+{
+    switch (light_kind(light))
     {
-        // depth cueing factor
-        float depth_cue_coeff = depth_cueing(p, scene.getEye(), scene.getDepthCue());
-        DepthCue depth_cue = scene.getDepthCue();
-        sum_r = depth_cue_coeff * sum_r + (1 - depth_cue_coeff) * depth_cue.dc_r;
-        sum_g = depth_cue_coeff * sum_g + (1 - depth_cue_coeff) * depth_cue.dc_g;
-        sum_b = depth_cue_coeff * sum_b + (1 - depth_cue_coeff) * depth_cue.dc_b;
+        case LIGHT_POINT:
+            return light_kernel<LIGHT_POINT>(scene, ctx, light, IL);
+        case LIGHT_DIRECTIONAL:
+            return light_kernel<LIGHT_DIRECTIONAL>(scene, ctx, light, IL);
+        default:
+            return light_kernel<LIGHT_NONE>(scene, ctx, light, IL);
     }
+}
 
-    return Color(sum_r, sum_g, sum_b);
+// add up to four light terms to sum, in order, with their specular powers taken in one call
+static inline void add_light_terms(const ShadeContext &ctx, const LightTerm *terms, int count, Vec4f &sum)
+{
+    float cos_h[4] = {0, 0, 0, 0};
+    for (int k = 0; k < count; k++)
+    {
+        cos_h[k] = terms[k].cos_h;
+    }
+    Vec4f power = fast_pow(Vec4f(cos_h[0], cos_h[1], cos_h[2], cos_h[3]), Vec4f::splat(ctx.n));
+    float term2[4] = {power.x(), power.y(), power.z(), power.w()};
+    for (int k = 0; k < count; k++)
+    {
+        Vec4f specular = ctx.Os * ctx.ks * term2[k];
+        sum += (terms[k].diffuse + specular) * terms[k].scale;
+    }
 }
 
-Color light_shade(const Scene &scene, const Ray &ray, float ray_t, const Light &light, std::string obj_type, int obj_idx)
+// shade one hit, specialized on the features of the hit object and the scene
+// the feature checks are done once by shade_ray, so nothing here is tested per light
+template <bool TEXTURE_MAP, bool NORMAL_MAP, bool DEPTH_CUE>
+static Color shade_kernel(const Scene &scene, ObjType obj_type, int obj_idx, const Ray &ray, float ray_t)
 {
-    // get the intersection point
-    FloatVec3 p = ray.extend(ray_t);
-    FloatVec3 dir = ray.getDir();
+    ShadeContext ctx;
+    // compute the intersection point
+    ctx.p = ray.extend(ray_t);
     const MaterialColor &cur_material = get_material(scene, obj_type, obj_idx);
-    Color Od_lambda = cur_material.getOd();
-    Color Os_lambda = cur_material.getOs();
-    FloatVec3 N = get_normal(scene, obj_type, obj_idx, p);
-    // calculate vector L
-    FloatVec3 L;
+    ctx.Od = cur_material.getOd().simd();
+    ctx.Os = cur_material.getOs().simd();
+    ctx.kd = cur_material.getKd();
+    ctx.ks = cur_material.getKs();
+    ctx.n = cur_material.getN();
+    ctx.N = get_normal(scene, obj_type, obj_idx, ctx.p).simd();
+    ctx.V = normalize3(-ray.getDir().simd());
     // compute the coresponding color from the texture coordinate
-    if (texture_map_enabled(scene, obj_type, obj_idx))
+    if (TEXTURE_MAP)
     {
-        Od_lambda = get_color(scene, obj_type, obj_idx, p);
-        if (normal_map_enabled(scene, obj_type, obj_idx))
+        float lod = texture_footprint(scene, obj_type, obj_idx, ray, ray_t, ctx.p);
+        ctx.Od = get_color(scene, obj_type, obj_idx, ctx.p, lod).simd();
+        if (NORMAL_MAP)
         {
             // if the normal map option is enabled, modified the current surface normal
-            N = normal_mapping(scene, obj_type, obj_idx, p);
+            ctx.N = normal_mapping(scene, obj_type, obj_idx, ctx.p, lod).simd();
         }
     }
-    if (std::abs(light.w - 1) < 1e-6) // point light source
+    // the three color channels are summed at once
+    Vec4f sum = ctx.Od * cur_material.getKa();
+    const std::vector<Light> &light_list = scene.getLightList();
+    const std::vector<AttLight> &attlight_list = scene.getAttLightList();
+    // light intensity for each component, just take the average for simplicity
+    float IL = 1.0 / (light_list.size() + attlight_list.size());
+    // the lights are gathered four at a time for their specular powers
+    LightTerm terms[4];
+    int pending = 0;
+    // illumination for normal light
+    for (size_t i = 0; i < light_list.size(); i++)
     {
-        L = FloatVec3(light.x - p.first, light.y - p.second, light.z - p.third).normal();
+        terms[pending++] = light_shade(scene, ctx, light_list[i], IL);
+        if (pending == 4)
+        {
+            add_light_terms(ctx, terms, pending, sum);
+            pending = 0;
+        }
     }
-    else if (std::abs(light.w - 0) < 1e-6) // directional light source
+    // illumination for attenuated light
+    for (size_t i = 0; i < attlight_list.size(); i++)
     {
-        L = FloatVec3(-light.x, -light.y, -light.z).normal();
+        terms[pending++] = light_shade(scene, ctx, attlight_list[i], IL);
+        if (pending == 4)
+        {
+            add_light_terms(ctx, terms, pending, sum);
+            pending = 0;
+        }
     }
-    // calculate vector H
-    // get the vector v
-    FloatVec3 V = FloatVec3(-dir.first, -dir.second, -dir.third).normal();
-    FloatVec3 H;
-    H = (V + L).normal();
+    add_light_terms(ctx, terms, pending, sum);
 
-    // apply the phong illumination model
-    float Ir, Ig, Ib;    // illumination components for R, G and B
-    float shadow = 1.0; // shadowing, dropping when the ray encounters any objects in the scene
+    // clamping
+    sum = min(sum, Vec4f::splat(1));
 
-    // check for shadowing effect
-    // cast a second ray forwarding from the intersection point
-    // to the point light source,
-    // and check for intersection with objects in the scene
-    Ray ray_second(p, L);
-    // check intersection, if intersected, set the flag to be 0
-    shadow = shadow_check(scene, ray_second, light);
+    // apply depth cueing
+    if (DEPTH_CUE)
+    {
+        // depth cueing factor
+        float depth_cue_coeff = depth_cueing(ctx.p, scene.getEye(), scene.getDepthCue());
+        const DepthCue &depth_cue = scene.getDepthCue();
+        Vec4f dc(depth_cue.dc_r, depth_cue.dc_g, depth_cue.dc_b);
+        sum = sum * depth_cue_coeff + dc * (1 - depth_cue_coeff);
+    }
 
-    float term1 = std::max(float(0), N.dot(L));
-    float term2 = pow(std::max(float(0), N.dot(H)), cur_material.getN());
-    Ir = shadow * (cur_material.getKd() * Od_lambda.getR() * term1 + cur_material.getKs() * Os_lambda.getR() * term2);
-    Ig = shadow * (cur_material.getKd() * Od_lambda.getG() * term1 + cur_material.getKs() * Os_lambda.getG() * term2);
-    Ib = shadow * (cur_material.getKd() * Od_lambda.getB() * term1 + cur_material.getKs() * Os_lambda.getB() * term2);
+    return Color(sum);
+}
 
-    return Color(Ir, Ig, Ib);
+typedef Color (*ShadeKernel)(const Scene &scene, ObjType obj_type, int obj_idx, const Ray &ray, float ray_t);
+
+// every combination of shading features, indexed by [texture map][normal map][depth cue]
+static const ShadeKernel shade_kernels[2][2][2] = {
+    {{shade_kernel<false, false, false>, shade_kernel<false, false, true>},
+     {shade_kernel<false, true, false>, shade_kernel<false, true, true>}},
+    {{shade_kernel<true, false, false>, shade_kernel<true, false, true>},
+     {shade_kernel<true, true, false>, shade_kernel<true, true, true>}},
+};
+
+Color shade_ray(const Scene &scene, ObjType obj_type, int obj_idx, const Ray &ray, float ray_t)
+{
+    PERF_SCOPE(PERF_SHADING);
+    // use The Phong Illumination Model to determine the color of the intersecting point
+    // select the kernel for the features of this hit, normal mapping only applies with a texture
+    bool texture_map = texture_map_enabled(scene, obj_type, obj_idx);
+    bool normal_map = texture_map && normal_map_enabled(scene, obj_type, obj_idx);
+    bool depth_cue = scene.depthCueEnable();
+    return shade_kernels[texture_map][normal_map][depth_cue](scene, obj_type, obj_idx, ray, ray_t);
 }
 
 float light_attenuation(const FloatVec3 &point, const AttLight &light)
@@ -516,33 +621,32 @@ float depth_cueing(const FloatVec3 &point, const FloatVec3 &viewer, const DepthC
     return alpha;
 }
 
-std::tuple<std::string, int, float> intersect_check(const Scene &scene, const Ray &ray)
+std::tuple<ObjType, int, float> intersect_check(const Scene &scene, const Ray &ray, RayCategory category)
 {
+    PERF_SCOPE(PERF_TRAVERSAL);
     float min_t = 100000;
     float temp_t;
     int obj_idx = -1;              // the ID (index) of the intersected object
-    std::string obj_type = "None"; // the type of the intersected object with the ray
-    float A, B, C, D;
-    float ray_t;
+    ObjType obj_type = OBJ_NONE; // the type of the intersected object with the ray
+    float B, C;
     float determinant;
-    FloatVec3 p; // intersection point
-    FloatVec3 ray_center, obj_center;
-    FloatVec3 dir;
+    // the ray stays in registers for the whole loop
+    Vec4f ray_center = ray.getCenter().simd();
+    Vec4f dir = ray.getDir().simd();
 
     // check intersection for spheres
-    for (auto s : scene.getSphereList())
-    {
-        ray_center = ray.getCenter();
-        obj_center = s.getCenter();
-        dir = ray.getDir();
-        B = 2 * (dir.first * (ray_center.first - obj_center.first) +
-                 dir.second * (ray_center.second - obj_center.second) +
-                 dir.third * (ray_center.third - obj_center.third));
-        C = pow(ray_center.first - obj_center.first, 2) +
-            pow(ray_center.second - obj_center.second, 2) +
-            pow(ray_center.third - obj_center.third, 2) -
-            pow(s.getRadius(), 2);
-        determinant = pow(B, 2) - 4 * C;
+    const std::vector<Sphere> &sphere_list = scene.getSphereList();
+    STATS_ADD(rays[category], 1);
+    STATS_ADD(sphere_tests[category], sphere_list.size());
+    for (size_t k = 0; k < sphere_list.size(); k++)
+    {
+        const Sphere &s = sphere_list[k];
+        Vec4f oc = ray_center - s.getCenter().simd();
+        B = 2 * dot3(dir, oc);
+        // B^2 - 4C cancels badly in single precision, so the squares are summed in double
+        C = double(oc.x()) * oc.x() + double(oc.y()) * oc.y() + double(oc.z()) * oc.z() -
+            double(s.getRadius()) * s.getRadius();
+        determinant = double(B) * B - 4.0 * C;
         if (determinant > 1e-6) // greater than or equal to 0
         {                        // need further check
             temp_t = (-B - sqrt(determinant)) / 2;
@@ -550,7 +654,7 @@ std::tuple<std::string, int, float> intersect_check(const Scene &scene, const Ra
             {
                 min_t = temp_t;
                 obj_idx = s.getID();
-                obj_type = "Sphere";
+                obj_type = OBJ_SPHERE;
             }
             // check for another possible solution
             temp_t = (-B + sqrt(determinant)) / 2;
@@ -558,77 +662,42 @@ std::tuple<std::string, int, float> intersect_check(const Scene &scene, const Ra
             {
                 min_t = temp_t;
                 obj_idx = s.getID();
-                obj_type = "Sphere";
+                obj_type = OBJ_SPHERE;
             }
         }
     }
 
-    // check intersection for triangles
-    for (auto t : scene.getTriangleList())
+    // check intersection for triangles, only their vertex indices are read here
+    // the kernel for the best instruction set of the host is picked on the first call
+    const std::vector<TriangleVertices> &triangle_vertex_list = scene.getTriangleVertexList();
+    int triangle_idx = -1;
+    STATS_ADD(triangle_tests[category], triangle_vertex_list.size());
+    intersect_triangles(triangle_vertex_list.data(), triangle_vertex_list.size(), scene.getVertexList().data(),
+                        ray_center, dir, min_t, triangle_idx);
+    if (triangle_idx != -1)
     {
-        ray_center = ray.getCenter();
-        dir = ray.getDir();
-        // parameters for the plane equation Ax + By + Cz + D = 0
-        FloatVec3 p0 = scene.getVertexList()[t.getV0idx() - 1].p;
-        FloatVec3 p1 = scene.getVertexList()[t.getV1idx() - 1].p;
-        FloatVec3 p2 = scene.getVertexList()[t.getV2idx() - 1].p;
-        FloatVec3 e1 = p1 - p0;
-        FloatVec3 e2 = p2 - p0;
-        FloatVec3 n = e1.cross(e2).normal();
-        A = n.first;
-        B = n.second;
-        C = n.third;
-        D = -A * p0.first - B * p0.second - C * p0.third;
-        determinant = A * dir.first + B * dir.second + C * dir.third;
-        // test whether the ray is parallel with the plane
-        if (std::abs(determinant) < 1e-6)
-        {
-            // in the case that the ray is parallel to the plane
-            continue;
-        }
-        ray_t = -(A * ray_center.first + B * ray_center.second + C * ray_center.third + D) / determinant;
-        if (ray_t < 0)
-        {
-            // no intersection
-            continue;
-        }
-        // get the intersection point p
-        p = ray.extend(ray_t);
-        FloatVec3 bayrcentric_coordinates = t.barycentric(scene, p);
-        float alpha = bayrcentric_coordinates.first;
-        float beta = bayrcentric_coordinates.second;
-        float gamma = bayrcentric_coordinates.third;
-        // test whether the intersection point is inside the triangle or not
-        if (alpha > -1e-6 && alpha < 1 && beta > -1e-6 && beta < 1 && gamma > -1e-6 && gamma < 1)
-        {
-            // in the triangle
-            if (ray_t < min_t && ray_t > 1e-3)
-            {
-                min_t = ray_t;
-                obj_idx = t.getID();
-                obj_type = "Triangle";
-            }
-        }
-        else
-        {
-            // if not inside the triangle, do nothing
-            continue;
-        }
+        obj_idx = triangle_idx;
+        obj_type = OBJ_TRIANGLE;
+    }
+    STATS_ADD(hits[category], obj_type != OBJ_NONE);
+    if (ray_log_enabled())
+    {
+        log_ray(ray, category, 1e-3f, 100000, obj_type, obj_idx, min_t);
     }
 
     return std::make_tuple(obj_type, obj_idx, min_t);
 }
 
-float shadow_check(const Scene &scene, const Ray &ray, const Light &light)
+float shadow_check(const Scene &scene, const Ray &ray, const Light &light, RayCategory category)
 {
-    std::string obj_type;
+    ObjType obj_type;
     int obj_idx;
     float ray_t; // material index
     // loop for all objects
     // check whether there is an intersection
-    std::tie(obj_type, obj_idx, ray_t) = intersect_check(scene, ray);
+    std::tie(obj_type, obj_idx, ray_t) = intersect_check(scene, ray, category);
 
-    if (obj_type != "None")
+    if (obj_type != OBJ_NONE)
     {
         // if it is a point light source
         // need further check whether the object is within the range between
@@ -642,13 +711,14 @@ float shadow_check(const Scene &scene, const Ray &ray, const Light &light)
                 float alpha = get_material(scene, obj_type, obj_idx).getAlpha();
                 if (std::abs(1 - alpha) < 1e-6)
                 {
+                    STATS_ADD(shadow_blocked, 1);
                     return 0;
                 } else
                 {   
                     FloatVec3 p = ray.extend(ray_t);
                     FloatVec3 ray_dir = ray.getDir();
                     Ray new_ray(p, ray_dir);
-                    return (1 - alpha) * shadow_check(scene, new_ray, light);
+                    return (1 - alpha) * shadow_check(scene, new_ray, light, RAY_SHADOW_RELAUNCH);
                 }
             }
         }
@@ -658,6 +728,7 @@ float shadow_check(const Scene &scene, const Ray &ray, const Light &light)
             // as long as the returned t is positive, there is shadow
             if (ray_t > 1e-6)
             {
+                STATS_ADD(shadow_blocked, 1);
                 return 0;
             }
         }
@@ -666,11 +737,16 @@ float shadow_check(const Scene &scene, const Ray &ray, const Light &light)
     return 1;
 }
 
-Color trace_ray_recursive(const Scene &scene, const Ray &ray, int depth, bool flag_enter, float dist, std::string obj_type, int obj_id)
+Color trace_ray_recursive(const Scene &scene, const Ray &ray, int depth, bool flag_enter, float dist, ObjType obj_type, int obj_id)
 {
     // termination condition
-    if (depth > MAX_DEPTH || obj_type == "None")
+    if (depth > MAX_DEPTH || obj_type == OBJ_NONE)
     {
+        // the path ended at the previous level
+        STATS_ADD(paths, 1);
+        STATS_ADD(path_depth, depth - 1);
+        STATS_ADD(paths_at_limit, depth > MAX_DEPTH);
+        STATS_ADD(paths_missed, depth <= MAX_DEPTH);
         return Color(0, 0, 0);
     }
     // compute the reflection ray equation and the Fresnel reflectance coefficient
@@ -688,20 +764,22 @@ Color trace_ray_recursive(const Scene &scene, const Ray &ray, int depth, bool fl
         eta_i = eta_t;
         eta_t = 1.0;
     }
-    float F_0 = pow((eta_t - eta_i) / (eta_t + eta_i), 2);
-    float F_r = F_0 + (1 - F_0) * pow(1 - N.dot(ray_dir), 5);
+    float F_0 = ipow<2>((eta_t - eta_i) / (eta_t + eta_i));
+    float F_r = F_0 + (1 - F_0) * ipow<5>(1 - N.dot(ray_dir));
     // compute the reflective ray
     FloatVec3 R = (N * 2 * N.dot(ray_dir) - ray_dir).normal();
-    std::string next_obj_type;
+    ObjType next_obj_type;
     int next_obj_idx;
     float ray_t; // material index
     Ray ray_reflected(p, R);
+    // the reflected ray carries on the cone of the incident ray
+    ray_reflected.setCone(ray.getConeWidth(), ray.getConeSpread());
     // initialize the color for the reflective ray
     Color res_color_reflect(0, 0, 0);
     // loop for all objects
     // check whether there is an intersection
-    std::tie(next_obj_type, next_obj_idx, ray_t) = intersect_check(scene, ray_reflected);
-    if (next_obj_type != "None")
+    std::tie(next_obj_type, next_obj_idx, ray_t) = intersect_check(scene, ray_reflected, RAY_REFLECTED);
+    if (next_obj_type != OBJ_NONE)
     {
         res_color_reflect = shade_ray(scene, next_obj_type, next_obj_idx, ray_reflected, ray_t);
     }
@@ -711,25 +789,30 @@ Color trace_ray_recursive(const Scene &scene, const Ray &ray, int depth, bool fl
     // new incident ray
     FloatVec3 new_dir = -ray_reflected.getDir().normal();
     Ray new_ray_incident(new_p, new_dir);
+    new_ray_incident.setCone(ray_reflected.coneWidth(ray_t), ray.getConeSpread());
     // recursive trace the reflective ray
-    res_color_reflect = res_color_reflect * pow(F_r, depth) + trace_ray_recursive(scene, new_ray_incident, depth + 1, flag_enter, dist + ray_t, next_obj_type, next_obj_idx);
+    res_color_reflect = res_color_reflect * powi(F_r, depth) + trace_ray_recursive(scene, new_ray_incident, depth + 1, flag_enter, dist + ray_t, next_obj_type, next_obj_idx);
 
     // initialize the response color for the transmitted ray
     Color res_color_transmit(0, 0, 0);
     // check the existence of the transmitted ray
-    if (std::abs(1 - mtl.getAlpha()) < 1e-6 || pow(N.dot(ray_dir), 2) < 1 - pow(eta_t / eta_i, 2))
+    if (std::abs(1 - mtl.getAlpha()) < 1e-6 || ipow<2>(N.dot(ray_dir)) < 1 - ipow<2>(eta_t / eta_i))
     {
         // if opaque or total internal reflection
         // there is no tranmitted ray
         return res_color_reflect;
     }
     // compute the tranmitted ray
-    FloatVec3 T = -N * sqrt(1 - pow(eta_i / eta_t, 2) * (1 - pow(N.dot(ray_dir), 2))) + (N * N.dot(ray_dir) - ray_dir) * (eta_i / eta_t);
+    // the radicand cancels near grazing angles, so it stays in double where the squares are exact
+    double cos_i = N.dot(ray_dir);
+    double eta_ratio = eta_i / eta_t;
+    FloatVec3 T = -N * sqrt(1 - eta_ratio * eta_ratio * (1 - cos_i * cos_i)) + (N * N.dot(ray_dir) - ray_dir) * (eta_i / eta_t);
     Ray ray_tranmitted(p, T);
+    ray_tranmitted.setCone(ray.getConeWidth(), ray.getConeSpread());
     // loop for all objects
     // check whether there is an intersection
-    std::tie(next_obj_type, next_obj_idx, ray_t) = intersect_check(scene, ray_tranmitted);
-    if (next_obj_type != "None")
+    std::tie(next_obj_type, next_obj_idx, ray_t) = intersect_check(scene, ray_tranmitted, RAY_TRANSMITTED);
+    if (next_obj_type != OBJ_NONE)
     {
         res_color_transmit = shade_ray(scene, next_obj_type, next_obj_idx, ray_tranmitted, ray_t);
     }
@@ -739,8 +822,9 @@ Color trace_ray_recursive(const Scene &scene, const Ray &ray, int depth, bool fl
     // new incident ray
     FloatVec3 new_dir_transmit = -ray_tranmitted.getDir().normal();
     Ray new_ray_incident_transmit(new_p_transmit, new_dir_transmit);
+    new_ray_incident_transmit.setCone(ray_tranmitted.coneWidth(ray_t), ray.getConeSpread());
     // recursive trace the transmitted ray
-    res_color_transmit = res_color_transmit * pow(1 - F_r, depth) * std::exp(-mtl.getAlpha() * dist) + trace_ray_recursive(scene, new_ray_incident_transmit, depth + 1, !flag_enter, dist + ray_t, next_obj_type, next_obj_idx);
+    res_color_transmit = res_color_transmit * powi(1 - F_r, depth) * std::exp(-mtl.getAlpha() * dist) + trace_ray_recursive(scene, new_ray_incident_transmit, depth + 1, !flag_enter, dist + ray_t, next_obj_type, next_obj_idx);
     return res_color_reflect + res_color_transmit;
 }
 
@@ -751,15 +835,17 @@ Color trace_ray(const Scene &scene, const ViewWindow &viewwindow, int w, int h)
     FloatVec3 point_in_view(viewwindow.ul + viewwindow.dh * w + viewwindow.dv * h);
     FloatVec3 raydir = (point_in_view - eye).normal();
     Ray ray(eye, raydir);  // the first ray
-    std::string obj_type;
+    // the cone of the first ray starts at the eye and spreads over one pixel
+    ray.setCone(0, std::atan(std::sqrt(viewwindow.dv.dot(viewwindow.dv)) / viewwindow.viewdist));
+    ObjType obj_type;
     int obj_idx;
     float ray_t; // material index
     // initialize the response color to be the background color
     Color res_color(scene.getBkgcolor());
     // loop for all objects
     // check whether there is an intersection
-    std::tie(obj_type, obj_idx, ray_t) = intersect_check(scene, ray);
-    if (obj_type == "None")
+    std::tie(obj_type, obj_idx, ray_t) = intersect_check(scene, ray, RAY_PRIMARY);
+    if (obj_type == OBJ_NONE)
     {
         // if the first ray does not intersect with anything, return the background color
         return res_color;
@@ -773,8 +859,9 @@ Color trace_ray(const Scene &scene, const ViewWindow &viewwindow, int w, int h)
     // the incident ray
     FloatVec3 I = -ray_dir.normal();
     Ray ray_incidence(p, I);
+    ray_incidence.setCone(ray.coneWidth(ray_t), ray.getConeSpread());
     Color final_color = res_color;
-    if (obj_type == "Sphere")
+    if (obj_type == OBJ_SPHERE)
     {
         final_color = final_color + trace_ray_recursive(scene, ray_incidence, 1, true, 0, obj_type, obj_idx);
     }
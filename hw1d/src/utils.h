@@ -13,16 +13,18 @@
 #include "color.h"
 #include "material_color.h"
 #include "texture.h"
+#include "image.h"
 #include "ray.h"
 #include "sphere.h"
 #include "cylinder.h"
 #include "triangle.h"
+#include "stats.h"
 
 // maximum recursion depth
 #define MAX_DEPTH 5
 
 // write to the outputfile in PPM format
-void output_image(std::string filename, Color **checkerboard, int width, int height);
+void output_image(std::string filename, const Image<Color> &checkerboard, int width, int height);
 
 // calculate the distance between two 2D points
 float distance_between_2D_points(FloatVec2 point1, FloatVec2 point2);
@@ -37,38 +39,43 @@ bool lie_within(float p, float e1, float e2);
 void view_window_init(const Scene &scene, ViewWindow &viewwindow, float viewdist);
 
 // get the material for illumination
-const MaterialColor &get_material(const Scene &scene, std::string obj_type, int obj_idx);
+const MaterialColor &get_material(const Scene &scene, ObjType obj_type, int obj_idx);
 
 // get the unit normal vector at some point
-FloatVec3 get_normal(const Scene &scene, std::string obj_type, int obj_idx, FloatVec3 &p);
+FloatVec3 get_normal(const Scene &scene, ObjType obj_type, int obj_idx, FloatVec3 &p);
 
 // check whether texture map is enabled for the current object
-bool texture_map_enabled(const Scene &scene, std::string obj_type, int obj_idx);
+bool texture_map_enabled(const Scene &scene, ObjType obj_type, int obj_idx);
 
 // check whether normal map is enabled for the current object
-bool normal_map_enabled(const Scene &scene, std::string obj_type, int obj_idx);
+bool normal_map_enabled(const Scene &scene, ObjType obj_type, int obj_idx);
 
 // get the texture map for the current object
-const Texture &get_texture(const Scene &scene, std::string obj_type, int obj_idx);
+const Texture &get_texture(const Scene &scene, ObjType obj_type, int obj_idx);
 
 // get the normal map for the current object
-const Bump &get_normal_map(const Scene &scene, std::string obj_type, int obj_idx);
+const Bump &get_normal_map(const Scene &scene, ObjType obj_type, int obj_idx);
 
 // get the texture cooridnate of a point
-FloatVec2 get_texture_coordinate(const Scene &scene, std::string obj_type, int obj_idx, FloatVec3 &p);
+FloatVec2 get_texture_coordinate(const Scene &scene, ObjType obj_type, int obj_idx, FloatVec3 &p);
 
-// get the intrinsic color from the texture coordinate
-Color get_color(const Scene &scene, std::string obj_type, int obj_idx, FloatVec3 &p);
+// get the log2 of the width of the ray cone footprint at the point p, in texture coordinate units
+// used to select the mipmap level, -INFINITY if the ray carries no cone
+float texture_footprint(const Scene &scene, ObjType obj_type, int obj_idx, const Ray &ray, float ray_t, FloatVec3 &p);
 
-// get the modified normal from the normal map
-FloatVec3 normal_mapping(const Scene &scene, std::string obj_type, int obj_idx, FloatVec3 &p);
+// get the intrinsic color from the texture coordinate, lod is given by texture_footprint
+Color get_color(const Scene &scene, ObjType obj_type, int obj_idx, FloatVec3 &p, float lod = -INFINITY);
+
+// get the modified normal from the normal map, lod is given by texture_footprint
+FloatVec3 normal_mapping(const Scene &scene, ObjType obj_type, int obj_idx, FloatVec3 &p, float lod = -INFINITY);
 
 // ray shading, obj_type is the type of the object, obj_idx is used to index a particular object list
 // ray_t is the parameter to define a ray
-Color shade_ray(const Scene &scene, std::string obj_type, int obj_idx, const Ray &ray, float ray_t);
+Color shade_ray(const Scene &scene, ObjType obj_type, int obj_idx, const Ray &ray, float ray_t);
 
 // check whether the ray intersects with any objects in the scene, by recursively tracing a secondary ray
-float shadow_check(const Scene &scene, const Ray &ray, const Light &light);
+// category is RAY_SHADOW for the first ray and RAY_SHADOW_RELAUNCH past a translucent object
+float shadow_check(const Scene &scene, const Ray &ray, const Light &light, RayCategory category);
 // light source attenuation
 float light_attenuation(const FloatVec3 &point, const AttLight &light);
 
@@ -76,19 +83,16 @@ float light_attenuation(const FloatVec3 &point, const AttLight &light);
 float depth_cueing(const FloatVec3 &point, const FloatVec3 &viewer, const DepthCue &depth_cue);
 
 // recursive call of ray tracing
-Color trace_ray_recursive(const Scene &scene, const Ray &ray, int depth, bool flag_enter, std::string obj_type, int obj_id);
+Color trace_ray_recursive(const Scene &scene, const Ray &ray, int depth, bool flag_enter, ObjType obj_type, int obj_id);
 
 // recursive call of to do reflection
-Color trace_ray_reflective(const Scene &scene, const Ray &ray, int depth, std::string exclude_type, int exclude_id);
+Color trace_ray_reflective(const Scene &scene, const Ray &ray, int depth, ObjType exclude_type, int exclude_id);
 
 // trace the ray from view origin to pixel on the image and return color info
 Color trace_ray(const Scene &scene, const ViewWindow &viewwindow, int w, int h);
 
-// illuminate the point using the Phong Illumination Model without attenuation or depth cueing
-Color light_shade(const Scene &scene, const Ray &ray, float ray_t, const Light &light, std::string obj_type, int obj_idx);
-
 // check ray intersection with objects in the scene and return the minimal t which leads to an intersection
-// the last parameter is used to avoid self-intersection (specify a excluding object that don't need to check)
-std::tuple<std::string, int, float> intersect_check(const Scene &scene, const Ray &ray);
+// category is the kind of ray, for the counters in stats.h
+std::tuple<ObjType, int, float> intersect_check(const Scene &scene, const Ray &ray, RayCategory category);
 
 #endif // SRC_UTILS_H_
@@ -0,0 +1,464 @@
+#!/usr/bin/env python3
+"""End-to-end regression harness for the ray tracers.
+
+Builds hw1a - hw1d in a scratch directory, renders every scene under their
+test case directories, holds each image to absolute limits against the
+reference stored next to it, and checks image drift, peak memory and, with a
+second make STATS=1 build where the Makefile has one, rays cast against a
+stored baseline. Wall time is reported, and only checked
+with --check-time.
+
+    python3 regression/regress.py                     # check against the baseline
+    python3 regression/regress.py --update-baseline   # record a new baseline
+
+Exits with 1 when an image or a measurement falls outside its tolerance.
+"""
+import argparse
+import json
+import math
+import os
+import re
+import shutil
+import subprocess
+import sys
+import tempfile
+import time
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+HOMEWORKS = {
+    'hw1a': 'test_cases_cylinder',
+    'hw1b': 'test_case',
+    'hw1c': 'test_case',
+    'hw1d': 'test_case',
+}
+# scene keywords that name a file the renderer reads
+ASSET_KEYWORDS = ('texture', 'bump', 'objfile')
+# a line the statistics build of a renderer prints on stderr to report how many rays it traced
+RAYS_PATTERN = re.compile(r'^rays cast:\s*(\d+)\s*$', re.MULTILINE)
+
+
+def read_ppm(path):
+    """Read a P3 or P6 image, returns (width, height, maxval, samples)."""
+    with open(path, 'rb') as f:
+        data = f.read()
+    tokens = []
+    pos = 0
+    # header: magic, width, height, maxval, with # comments allowed between them
+    while len(tokens) < 4:
+        while pos < len(data) and data[pos:pos + 1].isspace():
+            pos += 1
+        if data[pos:pos + 1] == b'#':
+            while pos < len(data) and data[pos:pos + 1] != b'\n':
+                pos += 1
+            continue
+        start = pos
+        while pos < len(data) and not data[pos:pos + 1].isspace():
+            pos += 1
+        tokens.append(data[start:pos].decode('ascii'))
+    magic, width, height, maxval = tokens[0], int(tokens[1]), int(tokens[2]), int(tokens[3])
+    count = width * height * 3
+    if magic == 'P3':
+        samples = [int(v) for v in data[pos:].split()[:count]]
+    elif magic == 'P6' and maxval < 256:
+        samples = list(data[pos + 1:pos + 1 + count])
+    else:
+        raise ValueError('%s: unsupported image format %s' % (path, magic))
+    if len(samples) != count:
+        raise ValueError('%s: expected %d samples, found %d' % (path, count, len(samples)))
+    return width, height, maxval, samples
+
+
+def compare_images(output, reference):
+    """Return (psnr, max_error) of output against reference, errors in 0-255 units."""
+    w0, h0, max0, a = read_ppm(output)
+    w1, h1, max1, b = read_ppm(reference)
+    if (w0, h0) != (w1, h1):
+        raise ValueError('size %dx%d does not match the reference %dx%d' % (w0, h0, w1, h1))
+    scale0 = 255.0 / max0
+    scale1 = 255.0 / max1
+    sum_sq = 0.0
+    max_error = 0.0
+    for x, y in zip(a, b):
+        d = abs(x * scale0 - y * scale1)
+        sum_sq += d * d
+        if d > max_error:
+            max_error = d
+    mse = sum_sq / len(a)
+    psnr = float('inf') if mse == 0 else 10 * math.log10(255.0 * 255.0 / mse)
+    return psnr, max_error, w0 * h0
+
+
+def scene_assets(scene):
+    """Names of the images and meshes a scene reads."""
+    assets = set()
+    with open(scene) as f:
+        for line in f:
+            words = line.split()
+            if len(words) >= 2 and words[0] in ASSET_KEYWORDS:
+                assets.add(words[1])
+    return assets
+
+
+def discover_cases(hw):
+    """Yield (name, scene, reference) for every scene with a reference image."""
+    base = os.path.join(ROOT, hw, HOMEWORKS[hw])
+    for case in sorted(os.listdir(base), key=natural_key):
+        case_dir = os.path.join(base, case)
+        if not os.path.isdir(case_dir):
+            continue
+        scenes = sorted(f for f in os.listdir(case_dir) if f.endswith('.txt'))
+        for scene in scenes:
+            path = os.path.join(case_dir, scene)
+            assets = scene_assets(path)
+            images = [f for f in os.listdir(case_dir) if f.endswith('.ppm') and f not in assets]
+            # prefer an image named after the scene, either scene.txt_raytracer.ppm or scene.ppm
+            stem = scene[:-len('.txt')]
+            named = sorted(f for f in images if f.startswith(scene) or f == stem + '.ppm')
+            if named:
+                reference = named[0]
+            elif len(scenes) == 1 and len(images) == 1:
+                reference = images[0]
+            else:
+                print('%s/%s: no reference image for %s, skipped' % (hw, case, scene), file=sys.stderr)
+                continue
+            name = '%s/%s' % (hw, case) if len(scenes) == 1 else '%s/%s/%s' % (hw, case, stem)
+            yield name, path, os.path.join(case_dir, reference)
+
+
+def natural_key(s):
+    return [int(t) if t.isdigit() else t for t in re.split(r'(\d+)', s)]
+
+
+def has_ray_counter(hw):
+    """Whether the Makefile of a homework has the make STATS=1 build that counts the rays."""
+    with open(os.path.join(ROOT, hw, 'src', 'Makefile')) as f:
+        return '$(STATS)' in f.read()
+
+
+def build(hw, cxx, out, stats=False):
+    """Build the renderer of a homework from a copy of its sources under out, returns the binary.
+
+    With stats, the copy is built with make STATS=1 so that the renderer counts its rays.
+    """
+    work = os.path.join(out, hw + '-stats' if stats else hw)
+    shutil.rmtree(work, ignore_errors=True)
+    # objects and binaries left in the tree, possibly for another platform, would count as up to date
+    shutil.copytree(os.path.join(ROOT, hw, 'src'), work,
+                    ignore=shutil.ignore_patterns('*.o', '*.ppm', '*.cache', 'raytracer', 'bench'))
+    cmd = ['make', '-C', work, 'raytracer']
+    if cxx:
+        cmd.append('CXX=' + cxx)
+    if stats:
+        cmd.append('STATS=1')
+    result = subprocess.run(cmd, stdout=subprocess.PIPE, stderr=subprocess.STDOUT, universal_newlines=True)
+    if result.returncode != 0:
+        sys.stderr.write(result.stdout)
+        raise RuntimeError('%s: build failed' % hw)
+    return os.path.join(work, 'raytracer')
+
+
+def read_peak_rss(pid):
+    """High water mark of the resident set of a running process in kB, 0 once it has exited."""
+    try:
+        with open('/proc/%d/status' % pid) as f:
+            for line in f:
+                if line.startswith('VmHWM:'):
+                    return int(line.split()[1])
+    except (IOError, OSError, ValueError):
+        pass
+    return 0
+
+
+def render(hw, binary, scene, timeout):
+    """Render one scene in a scratch directory.
+
+    Returns (directory, image, wall seconds, cpu seconds, peak_rss_kb, rays).
+    """
+    work = tempfile.mkdtemp(prefix='regress-')
+    try:
+        return render_in(hw, binary, scene, timeout, work)
+    except Exception:
+        shutil.rmtree(work, ignore_errors=True)
+        raise
+
+
+def render_in(hw, binary, scene, timeout, work):
+    src = os.path.join(ROOT, hw, 'src')
+    # the scene plus every image it reads, found next to the scene first and then in src
+    shutil.copy(scene, work)
+    for asset in scene_assets(scene):
+        for d in (os.path.dirname(scene), src):
+            if os.path.exists(os.path.join(d, asset)):
+                os.symlink(os.path.join(d, asset), os.path.join(work, asset))
+                break
+    before = set(os.listdir(work))
+    env = dict(os.environ)
+    # the parsed scene cache would hide parse time and leave files behind
+    env['RAYTRACER_CACHE'] = '0'
+    err_path = os.path.join(work, 'stderr.log')
+    with open(err_path, 'w') as err:
+        start = time.monotonic()
+        proc = subprocess.Popen([binary, os.path.basename(scene)],
+                                cwd=work, env=env, stdout=subprocess.DEVNULL, stderr=err)
+        deadline = start + timeout
+        peak_rss = 0
+        while True:
+            pid, status, usage = os.wait4(proc.pid, os.WNOHANG)
+            if pid:
+                break
+            peak_rss = max(peak_rss, read_peak_rss(proc.pid))
+            if time.monotonic() > deadline:
+                proc.kill()
+                os.wait4(proc.pid, 0)
+                raise RuntimeError('timed out after %d s' % timeout)
+            time.sleep(0.002)
+        seconds = time.monotonic() - start
+    with open(err_path) as f:
+        log = f.read()
+    if not os.WIFEXITED(status) or os.WEXITSTATUS(status) != 0:
+        raise RuntimeError('renderer failed with status %d\n%s' % (status, log))
+    images = [f for f in os.listdir(work) if f.endswith('.ppm') and f not in before]
+    if len(images) != 1:
+        raise RuntimeError('expected one output image, found %s' % images)
+    match = RAYS_PATTERN.findall(log)
+    rays = int(match[-1]) if match else None
+    # ru_maxrss also counts the pages the child had before exec, the size of this script,
+    # so it only stands in when the process ended before its own high water mark was read
+    cpu = usage.ru_utime + usage.ru_stime
+    return work, os.path.join(work, images[0]), seconds, cpu, peak_rss or usage.ru_maxrss, rays
+
+
+def count_rays(hw, stats_binary, scene, timeout):
+    """Rays cast rendering a scene with the statistics build, which is too slow to time."""
+    work, image, seconds, cpu, rss, rays = render(hw, stats_binary, scene, timeout)
+    shutil.rmtree(work, ignore_errors=True)
+    if rays is None:
+        raise RuntimeError('the statistics build printed no rays cast line')
+    return rays
+
+
+def run_case(hw, binary, stats_binary, name, scene, reference, args):
+    result = {}
+    for _ in range(args.repeat):
+        work, image, seconds, cpu, rss, rays = render(hw, binary, scene, args.timeout)
+        try:
+            if not result:
+                psnr, max_error, pixels = compare_images(image, reference)
+                result['psnr'] = psnr
+                result['max_error'] = max_error
+                # None for renderers without a ray counter, which are not checked on it
+                result['rays'] = count_rays(hw, stats_binary, scene, args.timeout) if stats_binary else rays
+                result['peak_rss_kb'] = rss
+                result['seconds'] = seconds
+                result['cpu_seconds'] = cpu
+            result['seconds'] = min(result['seconds'], seconds)
+            result['cpu_seconds'] = min(result['cpu_seconds'], cpu)
+            result['peak_rss_kb'] = max(result['peak_rss_kb'], rss)
+        finally:
+            shutil.rmtree(work, ignore_errors=True)
+    return result
+
+
+def check_limits(result, limits, args):
+    """Return the violations of the absolute limits on the distance of an image from its reference."""
+    failures = []
+    min_psnr = limits.get('min_psnr', args.min_psnr)
+    max_error = limits.get('max_error', args.max_error)
+    if result['psnr'] < min_psnr:
+        failures.append('PSNR %.2f dB below %.2f dB' % (result['psnr'], min_psnr))
+    if result['max_error'] > max_error:
+        failures.append('max error %.0f above %.0f' % (result['max_error'], max_error))
+    return failures
+
+
+def check(result, baseline, args):
+    """Return the list of drift violations of one case against its baseline."""
+    failures = []
+    if baseline is None:
+        return failures
+    psnr, max_error = result['psnr'], result['max_error']
+    # within the limits, a case may still not drift further from its reference than the baseline did
+    if math.isfinite(baseline['psnr']) and psnr < baseline['psnr'] - args.psnr_drop:
+        failures.append('PSNR %.2f dB, baseline %.2f dB' % (psnr, baseline['psnr']))
+    elif not math.isfinite(baseline['psnr']) and max_error > args.max_error_growth:
+        failures.append('baseline matched exactly, max error now %.0f' % max_error)
+    if max_error > baseline['max_error'] + args.max_error_growth:
+        failures.append('max error %.0f, baseline %.0f' % (max_error, baseline['max_error']))
+    # wall time depends on the machine and its load, it is only a gate on request
+    # small absolute changes are noise on the quick scenes
+    seconds, base_seconds = result['seconds'], baseline['seconds']
+    if args.check_time and seconds > base_seconds * (1 + args.time_tolerance) and \
+            seconds - base_seconds > args.min_time_delta:
+        failures.append('%.3f s, baseline %.3f s' % (seconds, base_seconds))
+    rss, base_rss = result['peak_rss_kb'], baseline['peak_rss_kb']
+    if rss > base_rss * (1 + args.rss_tolerance) and rss - base_rss > args.min_rss_delta_kb:
+        failures.append('peak RSS %d kB, baseline %d kB' % (rss, base_rss))
+    rays, base_rays = result['rays'], baseline.get('rays')
+    if rays is not None and base_rays is not None and rays > base_rays * (1 + args.rays_tolerance):
+        failures.append('%d rays, baseline %d' % (rays, base_rays))
+    return failures
+
+
+def load_limits(path):
+    """Per-case absolute limits, for the references that were made by earlier versions of the renderers.
+
+    A case may also name another reference image, relative to the repository, to be compared with.
+    """
+    if not os.path.exists(path):
+        return {}
+    with open(path) as f:
+        cases = json.load(f).get('cases', {})
+    for case in cases.values():
+        if 'reference' in case:
+            case['reference'] = os.path.join(ROOT, case['reference'])
+    return cases
+
+
+def load_baseline(path):
+    if not os.path.exists(path):
+        return {}
+    with open(path) as f:
+        data = json.load(f)
+    for case in data.get('cases', {}).values():
+        # json has no infinity, an exact match is stored as null
+        if case.get('psnr') is None:
+            case['psnr'] = float('inf')
+    return data.get('cases', {})
+
+
+def save_baseline(path, results):
+    cases = {}
+    for name, result in results.items():
+        case = dict(result)
+        if not math.isfinite(case['psnr']):
+            case['psnr'] = None
+        else:
+            case['psnr'] = round(case['psnr'], 3)
+        case['seconds'] = round(case['seconds'], 4)
+        case['cpu_seconds'] = round(case['cpu_seconds'], 4)
+        cases[name] = case
+    with open(path, 'w') as f:
+        json.dump({'cases': cases}, f, indent=2, sort_keys=True)
+        f.write('\n')
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.split('\n')[0])
+    parser.add_argument('homeworks', nargs='*', default=sorted(HOMEWORKS),
+                        help='homeworks to run (default: %(default)s)')
+    parser.add_argument('--baseline', default=os.path.join(ROOT, 'regression', 'baseline.json'))
+    parser.add_argument('--update-baseline', action='store_true',
+                        help='record the measurements as the new baseline instead of checking them')
+    parser.add_argument('--cxx', default=os.environ.get('CXX'),
+                        help='compiler passed to make (default: $CXX, or the Makefile default)')
+    parser.add_argument('--no-build', action='store_true', help='use the binaries already built in the source trees, '
+                        'without the statistics build that counts the rays')
+    parser.add_argument('--build-dir', help='build here instead of in a scratch directory removed at exit')
+    parser.add_argument('--filter', default='', help='only run cases whose name contains this')
+    parser.add_argument('--repeat', type=int, default=3, help='renders per case, the fastest one counts')
+    parser.add_argument('--timeout', type=float, default=600, help='seconds before a render is abandoned')
+    parser.add_argument('--limits', default=os.path.join(ROOT, 'regression', 'limits.json'),
+                        help='per-case absolute limits overriding --min-psnr and --max-error')
+    parser.add_argument('--min-psnr', type=float, default=40.0,
+                        help='lowest PSNR accepted against the reference, dB')
+    parser.add_argument('--max-error', type=float, default=2.0,
+                        help='largest per-channel error accepted against the reference, 0-255 units')
+    parser.add_argument('--psnr-drop', type=float, default=0.5, help='dB the PSNR may drop below the baseline')
+    parser.add_argument('--max-error-growth', type=float, default=2.0,
+                        help='units the max error may grow past the baseline')
+    parser.add_argument('--check-time', action='store_true',
+                        help='also fail on wall time, against a baseline recorded on this machine')
+    parser.add_argument('--time-tolerance', type=float, default=0.5,
+                        help='fraction the wall time may grow past the baseline')
+    parser.add_argument('--min-time-delta', type=float, default=0.1,
+                        help='seconds of growth ignored as noise')
+    parser.add_argument('--rss-tolerance', type=float, default=0.10,
+                        help='fraction the peak RSS may grow past the baseline')
+    parser.add_argument('--min-rss-delta-kb', type=int, default=1024, help='kB of growth ignored as noise')
+    parser.add_argument('--rays-tolerance', type=float, default=0.01,
+                        help='fraction the ray count may grow past the baseline')
+    parser.add_argument('--json', help='also write the measurements to this file')
+    args = parser.parse_args()
+
+    for hw in args.homeworks:
+        if hw not in HOMEWORKS:
+            parser.error('unknown homework %s' % hw)
+    out = args.build_dir or tempfile.mkdtemp(prefix='regress-build-')
+    try:
+        return run(args, out)
+    finally:
+        if not args.build_dir:
+            shutil.rmtree(out, ignore_errors=True)
+
+
+def run(args, out):
+    binaries = {}
+    # a second build per homework that can count its rays, timing stays on the plain build
+    stats_binaries = {}
+    for hw in args.homeworks:
+        stats_binaries[hw] = None
+        if args.no_build:
+            binaries[hw] = os.path.join(ROOT, hw, 'src', 'raytracer')
+            continue
+        try:
+            binaries[hw] = build(hw, args.cxx, out)
+            if has_ray_counter(hw):
+                stats_binaries[hw] = build(hw, args.cxx, out, stats=True)
+        except RuntimeError as e:
+            print(e)
+            return 1
+
+    baseline = load_baseline(args.baseline)
+    limits = load_limits(args.limits)
+    results = {}
+    failed = []
+    print('%-28s %9s %6s %9s %10s %10s  %s' % ('case', 'PSNR', 'max', 'seconds', 'rays', 'RSS kB', 'status'))
+    for hw in args.homeworks:
+        for name, scene, reference in discover_cases(hw):
+            if args.filter not in name:
+                continue
+            try:
+                result = run_case(hw, binaries[hw], stats_binaries[hw], name, scene,
+                                  limits.get(name, {}).get('reference', reference), args)
+            except (RuntimeError, ValueError, OSError) as e:
+                print('%-28s %s' % (name, e))
+                failed.append(name)
+                continue
+            results[name] = result
+            # a baseline is only recorded from images within the limits
+            failures = check_limits(result, limits.get(name, {}), args)
+            if not args.update_baseline:
+                failures += check(result, baseline.get(name), args)
+            if failures:
+                failed.append(name)
+                status = 'FAIL: ' + '; '.join(failures)
+            elif not args.update_baseline and name not in baseline:
+                status = 'ok (no baseline)'
+            else:
+                status = 'ok'
+            rays = '-' if result['rays'] is None else str(result['rays'])
+            print('%-28s %9.2f %6.0f %9.3f %10s %10d  %s' % (
+                name, result['psnr'], result['max_error'], result['seconds'],
+                rays, result['peak_rss_kb'], status))
+
+    if args.json:
+        with open(args.json, 'w') as f:
+            json.dump(results, f, indent=2, sort_keys=True, default=str)
+    if args.update_baseline:
+        if failed:
+            print('not updating the baseline, %d cases failed' % len(failed))
+            return 1
+        # keep the entries of homeworks or cases that were not run this time
+        baseline.update(results)
+        save_baseline(args.baseline, baseline)
+        print('baseline written to %s' % os.path.relpath(args.baseline))
+        return 0
+    if failed:
+        print('%d of %d cases regressed: %s' % (len(failed), len(results), ', '.join(failed)))
+        return 1
+    print('all %d cases passed' % len(results))
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())